@@ -0,0 +1,812 @@
+#include <clui/apropos.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(CONFIG_CLUI_PLUGIN)
+#include <clui/plugin.h>
+#endif /* defined(CONFIG_CLUI_PLUGIN) */
+
+/* Weights given to a word depending on where it shows up. */
+#define CLUI_APROPOS_LABEL_WEIGHT (16U)
+#define CLUI_APROPOS_KWORD_WEIGHT (4U)
+#define CLUI_APROPOS_TEXT_WEIGHT  (1U)
+#define CLUI_APROPOS_WEIGHT_MAX   (32U)
+
+/* Words longer than this are truncated. */
+#define CLUI_APROPOS_WORD_MAX     (CLUI_LABEL_MAX - 1)
+
+struct clui_apropos_post {
+	unsigned int entry;
+	unsigned int weight;
+};
+
+/* Indexed word along with the commands it shows up into. */
+struct clui_apropos_term {
+	unsigned int word;
+	unsigned int post;
+	unsigned int nr;
+};
+
+/*
+ * Inverted index: terms are sorted by word so that the ones starting with a
+ * given prefix are found using a binary search.
+ * Terms, postings and words either are allocated or point into a file
+ * mapping, see clui_apropos_load().
+ */
+struct clui_apropos_index {
+	unsigned int               entries_nr;
+	unsigned int               terms_nr;
+	unsigned int               posts_nr;
+	unsigned int               words_size;
+	struct clui_apropos_term * terms;
+	struct clui_apropos_post * posts;
+	char *                     words;
+	unsigned int *             scores;
+	unsigned int *             matched;
+	void *                     map;
+	size_t                     map_size;
+};
+
+/*
+ * Index file layout: this header followed by terms, postings, then words.
+ * All references are offsets or indices so that the file may be mapped at
+ * any address.
+ */
+#define CLUI_APROPOS_MAGIC   "cluiapro"
+#define CLUI_APROPOS_VERSION (1U)
+
+struct clui_apropos_head {
+	char     magic[8];
+	uint32_t version;
+	uint32_t entries_nr;
+	uint64_t labels_hash;
+	uint32_t terms_nr;
+	uint32_t posts_nr;
+	uint32_t words_size;
+	uint32_t pad;
+};
+
+/* Word occurrence collected while building the index. */
+struct clui_apropos_occur {
+	unsigned int word;
+	unsigned int entry;
+	unsigned int weight;
+};
+
+struct clui_apropos_build {
+	struct clui_apropos_occur * occurs;
+	unsigned int                nr;
+	unsigned int                size;
+	char *                      words;
+	size_t                      used;
+	size_t                      room;
+};
+
+static bool
+clui_apropos_isword(int chr)
+{
+	return isalnum(chr) || (chr == '_') || (chr == '-');
+}
+
+/*
+ * Extract next word out of text, lowercased into word. Returns the word
+ * length, 0 when text is exhausted.
+ */
+static size_t
+clui_apropos_next_word(const char ** text,
+                       char          word[CLUI_APROPOS_WORD_MAX + 1])
+{
+	const char * str = *text;
+	size_t       len;
+	size_t       w;
+
+	while (*str && (!clui_apropos_isword((unsigned char)*str) ||
+	                (*str == '-')))
+		str++;
+
+	for (len = 0; clui_apropos_isword((unsigned char)str[len]); len++)
+		;
+
+	*text = &str[len];
+
+	/* Strip trailing dashes, i.e. "--" separators and such. */
+	while (len && (str[len - 1] == '-'))
+		len--;
+
+	len = (len < CLUI_APROPOS_WORD_MAX) ? len : CLUI_APROPOS_WORD_MAX;
+	for (w = 0; w < len; w++)
+		word[w] = (char)tolower((unsigned char)str[w]);
+	word[len] = '\0';
+
+	return len;
+}
+
+static int
+clui_apropos_push_word(struct clui_apropos_build * build,
+                       const char *                word,
+                       size_t                      len,
+                       unsigned int                entry,
+                       unsigned int                weight)
+{
+	struct clui_apropos_occur * occur;
+
+	if (build->nr == build->size) {
+		unsigned int                size;
+		struct clui_apropos_occur * tmp;
+
+		size = build->size ? (2 * build->size) : 1024;
+		tmp = realloc(build->occurs, size * sizeof(tmp[0]));
+		if (!tmp)
+			return -ENOMEM;
+
+		build->occurs = tmp;
+		build->size = size;
+	}
+
+	if ((build->used + len + 1) > build->room) {
+		size_t room = build->room ? (2 * build->room) : 16384;
+		char * tmp;
+
+		tmp = realloc(build->words, room);
+		if (!tmp)
+			return -ENOMEM;
+
+		build->words = tmp;
+		build->room = room;
+	}
+
+	occur = &build->occurs[build->nr++];
+	occur->word = (unsigned int)build->used;
+	occur->entry = entry;
+	occur->weight = weight;
+
+	memcpy(&build->words[build->used], word, len + 1);
+	build->used += len + 1;
+
+	return 0;
+}
+
+static int
+clui_apropos_push_text(struct clui_apropos_build * build,
+                       const char *                text,
+                       unsigned int                entry,
+                       unsigned int                weight)
+{
+	char   word[CLUI_APROPOS_WORD_MAX + 1];
+	size_t len;
+
+	while ((len = clui_apropos_next_word(&text, word))) {
+		int err;
+
+		err = clui_apropos_push_word(build, word, len, entry, weight);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int
+clui_apropos_push_help(struct clui_apropos_build *       build,
+                       const struct clui_apropos_entry * entry,
+                       unsigned int                      index,
+                       const struct clui_parser *        parser)
+{
+	char * help = NULL;
+	size_t size;
+	FILE * stdio;
+	int    err;
+
+#if defined(CONFIG_CLUI_PLUGIN)
+	if (entry->cmd->help == clui_plugin_help) {
+		const struct clui_plugin_cmd * plug;
+
+		plug = clui_plugin_from_cmd(entry->cmd);
+		if (!clui_plugin_loaded(plug)) {
+			unsigned int h;
+
+			/*
+			 * Do not load plugins for the sake of indexing: use
+			 * the summary and hints the stub carries instead.
+			 */
+			err = clui_apropos_push_text(build,
+			                             plug->summary,
+			                             index,
+			                             CLUI_APROPOS_TEXT_WEIGHT);
+			for (h = 0; !err && (h < plug->hints_nr); h++)
+				err = clui_apropos_push_text(
+					build,
+					plug->hints[h],
+					index,
+					CLUI_APROPOS_KWORD_WEIGHT);
+
+			return err;
+		}
+	}
+#endif /* defined(CONFIG_CLUI_PLUGIN) */
+
+	stdio = open_memstream(&help, &size);
+	if (!stdio)
+		return -errno;
+
+	clui_help_cmd(entry->cmd, parser, stdio);
+
+	if (fclose(stdio)) {
+		free(help);
+		return -ENOMEM;
+	}
+
+	err = clui_apropos_push_text(build,
+	                             help,
+	                             index,
+	                             CLUI_APROPOS_TEXT_WEIGHT);
+
+	free(help);
+
+	return err;
+}
+
+static int
+clui_apropos_cmp_occurs(const void * first, const void * second, void * data)
+{
+	const struct clui_apropos_occur * fst = first;
+	const struct clui_apropos_occur * snd = second;
+	const char *                      words = data;
+	int                               ret;
+
+	ret = strcmp(&words[fst->word], &words[snd->word]);
+	if (ret)
+		return ret;
+
+	return (fst->entry > snd->entry) - (fst->entry < snd->entry);
+}
+
+/*
+ * Turn sorted word occurrences into terms and postings, merging occurrences
+ * of the same word into the same command.
+ */
+static int
+clui_apropos_merge(struct clui_apropos_index *       index,
+                   const struct clui_apropos_build * build)
+{
+	const struct clui_apropos_occur * occur = build->occurs;
+	const struct clui_apropos_occur * end = &occur[build->nr];
+	struct clui_apropos_term *        term = NULL;
+	struct clui_apropos_post *        post = NULL;
+	unsigned int                      nr = 0;
+	size_t                            used = 0;
+
+	index->terms = malloc(build->nr * sizeof(index->terms[0]));
+	index->posts = malloc(build->nr * sizeof(index->posts[0]));
+	index->words = malloc(build->used);
+	if (!index->terms || !index->posts || !index->words)
+		return -ENOMEM;
+
+	for (; occur < end; occur++) {
+		const char * word = &build->words[occur->word];
+
+		if (!term || strcmp(&index->words[term->word], word)) {
+			size_t len = strlen(word);
+
+			term = &index->terms[index->terms_nr++];
+			term->word = (unsigned int)used;
+			term->post = nr;
+			term->nr = 0;
+
+			memcpy(&index->words[used], word, len + 1);
+			used += len + 1;
+
+			post = NULL;
+		}
+
+		if (!post || (post->entry != occur->entry)) {
+			post = &index->posts[nr++];
+			post->entry = occur->entry;
+			post->weight = 0;
+			term->nr++;
+		}
+
+		post->weight += occur->weight;
+		if (post->weight > CLUI_APROPOS_WEIGHT_MAX)
+			post->weight = CLUI_APROPOS_WEIGHT_MAX;
+	}
+
+	index->posts_nr = nr;
+	index->words_size = (unsigned int)used;
+
+	return 0;
+}
+
+static void
+clui_apropos_free_index(struct clui_apropos_index * index)
+{
+	free(index->matched);
+	free(index->scores);
+
+	if (index->map)
+		munmap(index->map, index->map_size);
+	else {
+		free(index->words);
+		free(index->posts);
+		free(index->terms);
+	}
+
+	free(index);
+}
+
+static int
+clui_apropos_alloc_scores(struct clui_apropos_index * index, unsigned int nr)
+{
+	index->entries_nr = nr;
+	index->scores = malloc(nr * sizeof(index->scores[0]));
+	index->matched = malloc(nr * sizeof(index->matched[0]));
+	if (!index->scores || !index->matched)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static struct clui_apropos_index *
+clui_apropos_build_index(const struct clui_apropos *  apropos,
+                         const struct clui_parser *   parser)
+{
+	struct clui_apropos_build   build = { 0, };
+	struct clui_apropos_index * index;
+	unsigned int                e;
+	int                         err = -ENOMEM;
+
+	index = calloc(1, sizeof(*index));
+	if (!index)
+		goto err;
+
+	for (e = 0; e < apropos->nr; e++) {
+		const struct clui_apropos_entry * entry = &apropos->entries[e];
+		unsigned int                      k;
+
+		clui_assert_apropos_entry(entry);
+
+		err = clui_apropos_push_text(&build,
+		                             entry->label,
+		                             e,
+		                             CLUI_APROPOS_LABEL_WEIGHT);
+		for (k = 0; !err && (k < entry->kwords_nr); k++)
+			err = clui_apropos_push_text(&build,
+			                             entry->kwords[k],
+			                             e,
+			                             CLUI_APROPOS_KWORD_WEIGHT);
+		if (!err)
+			err = clui_apropos_push_help(&build, entry, e, parser);
+		if (err)
+			goto free;
+	}
+
+	err = -ENODATA;
+	if (!build.nr)
+		goto free;
+
+	qsort_r(build.occurs,
+	        build.nr,
+	        sizeof(build.occurs[0]),
+	        clui_apropos_cmp_occurs,
+	        build.words);
+
+	err = clui_apropos_merge(index, &build);
+	if (err)
+		goto free;
+
+	err = clui_apropos_alloc_scores(index, apropos->nr);
+	if (err)
+		goto free;
+
+	free(build.words);
+	free(build.occurs);
+
+	return index;
+
+free:
+	free(build.words);
+	free(build.occurs);
+	clui_apropos_free_index(index);
+err:
+	errno = -err;
+
+	return NULL;
+}
+
+/*
+ * Words of mapped indexes are not checked at loading time. Out of range ones
+ * are turned into the empty word, the words area being NULL terminated.
+ */
+static const char *
+clui_apropos_term_word(const struct clui_apropos_index * index,
+                       const struct clui_apropos_term *  term)
+{
+	return &index->words[(term->word < index->words_size) ?
+	                     term->word : (index->words_size - 1)];
+}
+
+/* Find the first term greater than or equal to word. */
+static unsigned int
+clui_apropos_lookup(const struct clui_apropos_index * index, const char * word)
+{
+	unsigned int lo = 0;
+	unsigned int hi = index->terms_nr;
+
+	while (lo < hi) {
+		unsigned int mid = lo + ((hi - lo) / 2);
+
+		if (strcmp(clui_apropos_term_word(index, &index->terms[mid]),
+		           word) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * Accumulate scores of commands holding a term starting with word. Only
+ * commands that matched all preceding query words are considered.
+ */
+static void
+clui_apropos_match(const struct clui_apropos_index * index,
+                   const char *                      word,
+                   size_t                            len,
+                   unsigned int                      rank)
+{
+	unsigned int t;
+
+	for (t = clui_apropos_lookup(index, word); t < index->terms_nr; t++) {
+		const struct clui_apropos_term * term = &index->terms[t];
+		const char *                     str;
+		unsigned int                     factor;
+		unsigned int                     p;
+
+		str = clui_apropos_term_word(index, term);
+		if (strncmp(str, word, len))
+			break;
+
+		if ((term->post > index->posts_nr) ||
+		    (term->nr > (index->posts_nr - term->post)))
+			/* Corrupted index file. */
+			continue;
+
+		/* Exact matches rank higher than prefix ones. */
+		factor = str[len] ? 1 : 2;
+
+		for (p = term->post; p < (term->post + term->nr); p++) {
+			const struct clui_apropos_post * post = &index->posts[p];
+
+			if ((post->entry >= index->entries_nr) ||
+			    (index->matched[post->entry] < rank))
+				continue;
+
+			index->matched[post->entry] = rank + 1;
+			index->scores[post->entry] += factor * post->weight;
+		}
+	}
+}
+
+/* Insert command into hits, keeping them sorted by decreasing score. */
+static void
+clui_apropos_rank(const struct clui_apropos * apropos,
+                  unsigned int                entry,
+                  unsigned int                score,
+                  struct clui_apropos_hit     hits[],
+                  unsigned int                nr,
+                  unsigned int                found)
+{
+	unsigned int h = (found < nr) ? found : nr;
+
+	if (!nr || ((h == nr) && (hits[nr - 1].score >= score)))
+		return;
+
+	if (h == nr)
+		h--;
+
+	while (h && (hits[h - 1].score < score)) {
+		hits[h] = hits[h - 1];
+		h--;
+	}
+
+	hits[h].entry = &apropos->entries[entry];
+	hits[h].score = score;
+}
+
+static struct clui_apropos_index *
+clui_apropos_get_index(struct clui_apropos *      apropos,
+                       const struct clui_parser * parser)
+{
+	if (!apropos->index)
+		apropos->index = clui_apropos_build_index(apropos, parser);
+
+	return apropos->index;
+}
+
+/*
+ * Identify the commands table an index file was built for, so that files
+ * left behind by another version of the program are not used.
+ */
+static uint64_t
+clui_apropos_hash_labels(const struct clui_apropos * apropos)
+{
+	uint64_t     hash = UINT64_C(0xcbf29ce484222325);
+	unsigned int e;
+
+	for (e = 0; e < apropos->nr; e++) {
+		const struct clui_apropos_entry * entry = &apropos->entries[e];
+		const char *                      str;
+		unsigned int                      k;
+
+		for (str = entry->label; *str; str++)
+			hash = (hash ^ (unsigned char)*str) *
+			       UINT64_C(0x100000001b3);
+		hash = (hash ^ '\n') * UINT64_C(0x100000001b3);
+
+		for (k = 0; k < entry->kwords_nr; k++) {
+			for (str = entry->kwords[k]; *str; str++)
+				hash = (hash ^ (unsigned char)*str) *
+				       UINT64_C(0x100000001b3);
+			hash = (hash ^ ' ') * UINT64_C(0x100000001b3);
+		}
+	}
+
+	return hash;
+}
+
+static int
+clui_apropos_write(int fd, const void * data, size_t size)
+{
+	const char * buff = data;
+
+	while (size) {
+		ssize_t ret;
+
+		ret = write(fd, buff, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		buff += ret;
+		size -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+int __clui_nonull(1, 2, 3)
+clui_apropos_save(struct clui_apropos *      apropos,
+                  const struct clui_parser * parser,
+                  const char *               path)
+{
+	clui_assert_apropos(apropos);
+	clui_assert_parser(parser);
+	clui_assert(path);
+
+	const struct clui_apropos_index * index;
+	struct clui_apropos_head          head = {
+		.magic   = CLUI_APROPOS_MAGIC,
+		.version = CLUI_APROPOS_VERSION
+	};
+	char                              tmp[PATH_MAX];
+	int                               fd;
+	int                               err;
+
+	index = clui_apropos_get_index(apropos, parser);
+	if (!index)
+		return -errno;
+
+	head.entries_nr = apropos->nr;
+	head.labels_hash = clui_apropos_hash_labels(apropos);
+	head.terms_nr = index->terms_nr;
+	head.posts_nr = index->posts_nr;
+	head.words_size = index->words_size;
+
+	/* Write to a temporary file first so that readers never see it partial. */
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+		return -ENAMETOOLONG;
+
+	fd = mkostemp(tmp, O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	err = clui_apropos_write(fd, &head, sizeof(head));
+	if (!err)
+		err = clui_apropos_write(fd,
+		                         index->terms,
+		                         index->terms_nr *
+		                         sizeof(index->terms[0]));
+	if (!err)
+		err = clui_apropos_write(fd,
+		                         index->posts,
+		                         index->posts_nr *
+		                         sizeof(index->posts[0]));
+	if (!err)
+		err = clui_apropos_write(fd, index->words, index->words_size);
+	if (!err && fchmod(fd, 0644))
+		err = -errno;
+
+	if (close(fd) && !err)
+		err = -errno;
+
+	if (!err && rename(tmp, path))
+		err = -errno;
+
+	if (err)
+		unlink(tmp);
+
+	return err;
+}
+
+static int
+clui_apropos_check_head(const struct clui_apropos *      apropos,
+                        const struct clui_apropos_head * head,
+                        size_t                           size)
+{
+	if ((size < sizeof(*head)) ||
+	    memcmp(head->magic, CLUI_APROPOS_MAGIC, sizeof(head->magic)) ||
+	    (head->version != CLUI_APROPOS_VERSION))
+		return -ENOEXEC;
+
+	if ((head->entries_nr != apropos->nr) ||
+	    (head->labels_hash != clui_apropos_hash_labels(apropos)))
+		return -ESTALE;
+
+	if (!head->words_size ||
+	    (size != (sizeof(*head) +
+	              ((size_t)head->terms_nr *
+	               sizeof(struct clui_apropos_term)) +
+	              ((size_t)head->posts_nr *
+	               sizeof(struct clui_apropos_post)) +
+	              head->words_size)) ||
+	    ((const char *)head)[size - 1])
+		return -ENOEXEC;
+
+	return 0;
+}
+
+int __clui_nonull(1, 2)
+clui_apropos_load(struct clui_apropos * apropos, const char * path)
+{
+	clui_assert_apropos(apropos);
+	clui_assert(path);
+
+	int                         fd;
+	struct stat                 st;
+	void *                      map;
+	struct clui_apropos_index * index;
+	const char *                data;
+	int                         err;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st)) {
+		err = -errno;
+		goto close;
+	}
+
+	if (st.st_size < (off_t)sizeof(struct clui_apropos_head)) {
+		err = -ENOEXEC;
+		goto close;
+	}
+
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		err = -errno;
+		goto close;
+	}
+
+	close(fd);
+
+	err = clui_apropos_check_head(apropos, map, (size_t)st.st_size);
+	if (err)
+		goto unmap;
+
+	index = calloc(1, sizeof(*index));
+	if (!index) {
+		err = -ENOMEM;
+		goto unmap;
+	}
+
+	index->map = map;
+	index->map_size = (size_t)st.st_size;
+	index->terms_nr = ((const struct clui_apropos_head *)map)->terms_nr;
+	index->posts_nr = ((const struct clui_apropos_head *)map)->posts_nr;
+	index->words_size = ((const struct clui_apropos_head *)map)->words_size;
+
+	data = (const char *)map + sizeof(struct clui_apropos_head);
+	index->terms = (struct clui_apropos_term *)data;
+	data += index->terms_nr * sizeof(index->terms[0]);
+	index->posts = (struct clui_apropos_post *)data;
+	data += index->posts_nr * sizeof(index->posts[0]);
+	index->words = (char *)data;
+
+	err = clui_apropos_alloc_scores(index, apropos->nr);
+	if (err) {
+		clui_apropos_free_index(index);
+		return err;
+	}
+
+	clui_apropos_fini(apropos);
+	apropos->index = index;
+
+	return 0;
+
+unmap:
+	munmap(map, (size_t)st.st_size);
+
+	return err;
+
+close:
+	close(fd);
+
+	return err;
+}
+
+int __clui_nonull(1, 2, 3)
+clui_apropos_search(struct clui_apropos *      apropos,
+                    const struct clui_parser * parser,
+                    const char *               query,
+                    struct clui_apropos_hit    hits[],
+                    unsigned int               nr)
+{
+	clui_assert_apropos(apropos);
+	clui_assert_parser(parser);
+	clui_assert(query);
+	clui_assert(!nr || hits);
+
+	struct clui_apropos_index * index;
+	char                        word[CLUI_APROPOS_WORD_MAX + 1];
+	size_t                      len;
+	unsigned int                rank = 0;
+	unsigned int                e;
+	unsigned int                found = 0;
+
+	index = clui_apropos_get_index(apropos, parser);
+	if (!index)
+		return -errno;
+
+	memset(index->scores, 0, apropos->nr * sizeof(index->scores[0]));
+	memset(index->matched, 0, apropos->nr * sizeof(index->matched[0]));
+
+	while ((len = clui_apropos_next_word(&query, word)))
+		clui_apropos_match(index, word, len, rank++);
+
+	if (!rank)
+		return -EINVAL;
+
+	for (e = 0; e < apropos->nr; e++) {
+		if (index->matched[e] != rank)
+			continue;
+
+		clui_apropos_rank(apropos, e, index->scores[e], hits, nr, found);
+		found++;
+	}
+
+	return (int)found;
+}
+
+void __clui_nonull(1)
+clui_apropos_fini(struct clui_apropos * apropos)
+{
+	clui_assert(apropos);
+
+	if (apropos->index) {
+		clui_apropos_free_index(apropos->index);
+		apropos->index = NULL;
+	}
+}
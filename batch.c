@@ -0,0 +1,536 @@
+#include <clui/batch.h>
+#include "mem_priv.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+ * Maximum number of script commands loaded at once. Script is processed by
+ * windows of commands so that memory usage remains bounded whatever the
+ * script size. Window boundaries behave as implicit barriers.
+ */
+#define CLUI_BATCH_WINDOW   (1024U)
+
+/* Size of groups hash table, i.e. a power of 2 greater than window size. */
+#define CLUI_BATCH_GROUP_NR (2U * CLUI_BATCH_WINDOW)
+
+struct clui_batch_cmd {
+	unsigned int line;
+	unsigned int group;
+	int          prev;
+	int          next;
+	int          fence;
+	bool         queued;
+	bool         done;
+	int          ret;
+	char *       ln;
+	char **      argv;
+	void *       ctx;
+	char *       out;
+	size_t       out_len;
+};
+
+struct clui_batch_group {
+	unsigned int group;
+	int          last;
+};
+
+struct clui_batch {
+	pthread_mutex_t               lock;
+	pthread_cond_t                ready;
+	pthread_cond_t                done;
+	const struct clui_batch_ops * ops;
+	void *                        data;
+	FILE *                        stdio;
+	unsigned int                  nr;
+	unsigned int                  flushed;
+	unsigned int                  head;
+	unsigned int                  cnt;
+	int                           ret;
+	bool                          stop;
+	char *                        ctxs;
+	unsigned int                  queue[CLUI_BATCH_WINDOW];
+	struct clui_batch_cmd         cmds[CLUI_BATCH_WINDOW];
+	struct clui_batch_group       groups[CLUI_BATCH_GROUP_NR];
+};
+
+static void
+clui_batch_enqueue(struct clui_batch * batch, unsigned int c)
+{
+	clui_assert(batch);
+	clui_assert(c < batch->nr);
+	clui_assert(!batch->cmds[c].queued);
+	clui_assert(batch->cnt < batch->nr);
+
+	batch->queue[(batch->head + batch->cnt) % CLUI_BATCH_WINDOW] = c;
+	batch->cnt++;
+	batch->cmds[c].queued = true;
+
+	pthread_cond_signal(&batch->ready);
+}
+
+static unsigned int
+clui_batch_dequeue(struct clui_batch * batch)
+{
+	clui_assert(batch);
+	clui_assert(batch->cnt);
+
+	unsigned int c = batch->queue[batch->head];
+
+	batch->head = (batch->head + 1) % CLUI_BATCH_WINDOW;
+	batch->cnt--;
+
+	return c;
+}
+
+/*
+ * Queue commands following the fence located just before the command at
+ * index "from" and which do not depend on a command of the same group located
+ * past this fence.
+ */
+static void
+clui_batch_release(struct clui_batch * batch, unsigned int from)
+{
+	unsigned int c;
+
+	for (c = from;
+	     (c < batch->nr) && (batch->cmds[c].group != CLUI_BATCH_BARRIER);
+	     c++) {
+		if (batch->cmds[c].prev < (int)from)
+			clui_batch_enqueue(batch, c);
+	}
+}
+
+/*
+ * Output results of completed commands in script order and queue the next
+ * barrier once all commands preceding it have completed.
+ */
+static void
+clui_batch_flush(struct clui_batch * batch)
+{
+	while (batch->flushed < batch->nr) {
+		struct clui_batch_cmd * cmd = &batch->cmds[batch->flushed];
+
+		if (!cmd->done) {
+			if ((cmd->group == CLUI_BATCH_BARRIER) && !cmd->queued)
+				clui_batch_enqueue(batch, batch->flushed);
+			return;
+		}
+
+		if (cmd->out_len)
+			fwrite(cmd->out, 1, cmd->out_len, batch->stdio);
+		free(cmd->out);
+		cmd->out = NULL;
+
+		batch->flushed++;
+	}
+
+	fflush(batch->stdio);
+	pthread_cond_broadcast(&batch->done);
+}
+
+static void
+clui_batch_complete(struct clui_batch * batch, unsigned int c, int ret)
+{
+	struct clui_batch_cmd * cmd = &batch->cmds[c];
+
+	cmd->done = true;
+	cmd->ret = ret;
+	if (ret && !batch->ret)
+		/* Stop starting new commands on first failure. */
+		batch->ret = ret;
+
+	if (cmd->group == CLUI_BATCH_BARRIER)
+		clui_batch_release(batch, c + 1);
+	else if ((cmd->next >= 0) &&
+	         (batch->cmds[cmd->next].fence == cmd->fence))
+		clui_batch_enqueue(batch, cmd->next);
+
+	clui_batch_flush(batch);
+}
+
+static int
+clui_batch_exec(const struct clui_batch * batch, struct clui_batch_cmd * cmd)
+{
+	FILE * stdio;
+	int    ret;
+
+	stdio = open_memstream(&cmd->out, &cmd->out_len);
+	if (!stdio)
+		return -errno;
+
+	ret = batch->ops->exec(cmd->ctx, stdio, batch->data);
+
+	if (fclose(stdio) && !ret)
+		ret = -errno;
+
+	return ret;
+}
+
+static void *
+clui_batch_worker(void * arg)
+{
+	struct clui_batch * batch = arg;
+
+	pthread_mutex_lock(&batch->lock);
+
+	while (true) {
+		unsigned int c;
+		int          ret;
+
+		while (!batch->cnt && !batch->stop)
+			pthread_cond_wait(&batch->ready, &batch->lock);
+
+		if (batch->stop)
+			break;
+
+		c = clui_batch_dequeue(batch);
+
+		if (!batch->ret) {
+			pthread_mutex_unlock(&batch->lock);
+			ret = clui_batch_exec(batch, &batch->cmds[c]);
+			pthread_mutex_lock(&batch->lock);
+		}
+		else
+			/* A previous command failed: skip execution. */
+			ret = -ECANCELED;
+
+		clui_batch_complete(batch, c, ret);
+	}
+
+	pthread_mutex_unlock(&batch->lock);
+
+	return NULL;
+}
+
+static int
+clui_batch_split_line(char *** restrict argv,
+                      char * restrict   line,
+                      char *            argv0)
+{
+	unsigned int nr = 8;
+	unsigned int cnt = 0;
+	char **      args;
+
+	args = clui_mem_alloc(CLUI_MEM_RUN_SYS, nr * sizeof(args[0]));
+	if (!args)
+		return -errno;
+
+	args[cnt++] = argv0;
+
+	while (true) {
+		while (isspace((unsigned char)*line))
+			line++;
+
+		if (!*line || (*line == '#'))
+			/* End of line or start of comment. */
+			break;
+
+		if ((cnt + 1) == nr) {
+			char ** tmp;
+
+			nr *= 2;
+			tmp = clui_mem_realloc(CLUI_MEM_RUN_SYS,
+			                       args,
+			                       nr * sizeof(args[0]));
+			if (!tmp) {
+				clui_mem_free(CLUI_MEM_RUN_SYS, args);
+				return -errno;
+			}
+
+			args = tmp;
+		}
+
+		args[cnt++] = line;
+
+		while (*line && !isspace((unsigned char)*line))
+			line++;
+
+		if (*line)
+			*line++ = '\0';
+	}
+
+	args[cnt] = NULL;
+	*argv = args;
+
+	return cnt;
+}
+
+static unsigned int
+clui_batch_hash_group(unsigned int group)
+{
+	/* Fibonacci hashing. */
+	return (group * 2654435769U) % CLUI_BATCH_GROUP_NR;
+}
+
+/* Return index of last command belonging to group and register the new one. */
+static int
+clui_batch_link_group(struct clui_batch * batch, unsigned int group, int last)
+{
+	unsigned int h = clui_batch_hash_group(group);
+
+	while (batch->groups[h].last >= 0) {
+		if (batch->groups[h].group == group) {
+			int prev = batch->groups[h].last;
+
+			batch->groups[h].last = last;
+
+			return prev;
+		}
+
+		h = (h + 1) % CLUI_BATCH_GROUP_NR;
+	}
+
+	batch->groups[h].group = group;
+	batch->groups[h].last = last;
+
+	return -1;
+}
+
+static void
+clui_batch_reset(struct clui_batch * batch)
+{
+	unsigned int g;
+
+	batch->nr = 0;
+	batch->flushed = 0;
+	batch->head = 0;
+	batch->cnt = 0;
+
+	for (g = 0; g < CLUI_BATCH_GROUP_NR; g++)
+		batch->groups[g].last = -1;
+}
+
+static int
+clui_batch_load(struct clui_batch *        batch,
+                struct clui_parser *       parser,
+                const struct clui_opt_set *set,
+                const struct clui_cmd *    cmd,
+                FILE *                     script,
+                unsigned int *             line)
+{
+	const struct clui_batch_ops * ops = batch->ops;
+	int                           fence = -1;
+
+	clui_batch_reset(batch);
+
+	while (batch->nr < CLUI_BATCH_WINDOW) {
+		struct clui_batch_cmd * bcmd = &batch->cmds[batch->nr];
+		char *                  ln = NULL;
+		size_t                  sz = 0;
+		char **                 argv = NULL;
+		int                     argc;
+		int                     ret;
+
+		if (getline(&ln, &sz, script) < 0) {
+			free(ln);
+			return ferror(script) ? -EIO : 0;
+		}
+
+		(*line)++;
+
+		argc = clui_batch_split_line(&argv, ln, parser->argv0);
+		if (argc < 0) {
+			free(ln);
+			return argc;
+		}
+
+		if (argc == 1) {
+			/* Skip empty and comment lines. */
+			clui_mem_free(CLUI_MEM_RUN_SYS, argv);
+			free(ln);
+			continue;
+		}
+
+		bcmd->ctx = &batch->ctxs[batch->nr * ops->ctx_size];
+		memset(bcmd->ctx, 0, ops->ctx_size);
+		if (ops->init) {
+			ret = ops->init(bcmd->ctx, batch->data);
+			if (ret)
+				goto free;
+		}
+
+		/*
+		 * Parsing is serialized here since getopt_long() relies upon
+		 * global state.
+		 */
+		optind = 0;
+		ret = clui_parse(parser, set, cmd, argc, argv, bcmd->ctx);
+		if (ret) {
+			clui_err(parser, "script line %u: invalid command.\n", *line);
+			if (ops->fini)
+				ops->fini(bcmd->ctx, batch->data);
+			goto free;
+		}
+
+		bcmd->line = *line;
+		bcmd->group = ops->group ? ops->group(bcmd->ctx, batch->data) :
+		                           CLUI_BATCH_BARRIER;
+		bcmd->next = -1;
+		bcmd->fence = fence;
+		bcmd->queued = false;
+		bcmd->done = false;
+		bcmd->ret = 0;
+		bcmd->ln = ln;
+		bcmd->argv = argv;
+		bcmd->out = NULL;
+		bcmd->out_len = 0;
+
+		if (bcmd->group != CLUI_BATCH_BARRIER) {
+			bcmd->prev = clui_batch_link_group(batch,
+			                                   bcmd->group,
+			                                   batch->nr);
+			if (bcmd->prev >= 0)
+				batch->cmds[bcmd->prev].next = batch->nr;
+		}
+		else {
+			bcmd->prev = -1;
+			fence = batch->nr;
+		}
+
+		batch->nr++;
+
+		continue;
+
+free:
+		clui_mem_free(CLUI_MEM_RUN_SYS, argv);
+		free(ln);
+
+		return (ret < 0) ? ret : -EINVAL;
+	}
+
+	return 0;
+}
+
+static int
+clui_batch_run_window(struct clui_batch * batch)
+{
+	unsigned int c;
+	int          ret;
+
+	pthread_mutex_lock(&batch->lock);
+
+	batch->ret = 0;
+	clui_batch_release(batch, 0);
+	clui_batch_flush(batch);
+
+	while (batch->flushed < batch->nr)
+		pthread_cond_wait(&batch->done, &batch->lock);
+
+	ret = batch->ret;
+
+	pthread_mutex_unlock(&batch->lock);
+
+	for (c = 0; c < batch->nr; c++) {
+		struct clui_batch_cmd * cmd = &batch->cmds[c];
+
+		if (cmd->ret && (cmd->ret != -ECANCELED))
+			fprintf(stderr,
+			        "script line %u: command failed (%d).\n",
+			        cmd->line,
+			        cmd->ret);
+
+		if (batch->ops->fini)
+			batch->ops->fini(cmd->ctx, batch->data);
+		clui_mem_free(CLUI_MEM_RUN_SYS, cmd->argv);
+		free(cmd->ln);
+	}
+
+	return ret;
+}
+
+int __clui_nonull(1, 4, 5, 6)
+clui_batch_run(struct clui_parser *          parser,
+               const struct clui_opt_set *   set,
+               const struct clui_cmd *       cmd,
+               const struct clui_batch_ops * ops,
+               FILE *                        script,
+               FILE *                        stdio,
+               unsigned int                  workers,
+               void *                        data)
+{
+	clui_assert_parser(parser);
+	clui_assert(set || cmd);
+	clui_assert_batch_ops(ops);
+	clui_assert(script);
+	clui_assert(stdio);
+
+	struct clui_batch * batch;
+	pthread_t *         thrs;
+	unsigned int        t;
+	unsigned int        line = 0;
+	int                 ret;
+
+	if (!workers) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		workers = (cpus > 0) ? (unsigned int)cpus : 1;
+	}
+	workers = (workers < CLUI_BATCH_WINDOW) ? workers : CLUI_BATCH_WINDOW;
+
+	batch = clui_mem_alloc(CLUI_MEM_RUN_SYS, sizeof(*batch));
+	if (!batch)
+		return -errno;
+
+	batch->ctxs = clui_mem_alloc(CLUI_MEM_RUN_SYS,
+	                             CLUI_BATCH_WINDOW * ops->ctx_size);
+	thrs = clui_mem_alloc(CLUI_MEM_RUN_SYS, workers * sizeof(thrs[0]));
+	if (!batch->ctxs || !thrs) {
+		ret = -errno;
+		goto free;
+	}
+
+	pthread_mutex_init(&batch->lock, NULL);
+	pthread_cond_init(&batch->ready, NULL);
+	pthread_cond_init(&batch->done, NULL);
+	batch->ops = ops;
+	batch->data = data;
+	batch->stdio = stdio;
+	batch->stop = false;
+
+	for (t = 0; t < workers; t++) {
+		ret = pthread_create(&thrs[t], NULL, clui_batch_worker, batch);
+		if (ret) {
+			if (!t) {
+				ret = -ret;
+				goto destroy;
+			}
+			break;
+		}
+	}
+	workers = t;
+
+	do {
+		int err;
+
+		ret = clui_batch_load(batch, parser, set, cmd, script, &line);
+
+		/* Run commands preceding a possible faulty line anyway. */
+		err = batch->nr ? clui_batch_run_window(batch) : 0;
+		if (!ret)
+			ret = err;
+	} while (!ret && !feof(script));
+
+	pthread_mutex_lock(&batch->lock);
+	batch->stop = true;
+	pthread_cond_broadcast(&batch->ready);
+	pthread_mutex_unlock(&batch->lock);
+
+	for (t = 0; t < workers; t++)
+		pthread_join(thrs[t], NULL);
+
+destroy:
+	pthread_cond_destroy(&batch->done);
+	pthread_cond_destroy(&batch->ready);
+	pthread_mutex_destroy(&batch->lock);
+free:
+	clui_mem_free(CLUI_MEM_RUN_SYS, thrs);
+	clui_mem_free(CLUI_MEM_RUN_SYS, batch->ctxs);
+	clui_mem_free(CLUI_MEM_RUN_SYS, batch);
+
+	return ret;
+}
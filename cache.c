@@ -0,0 +1,256 @@
+#include <clui/cache.h>
+#include "mem_priv.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#define CLUI_CACHE_FNV_OFFSET (UINT64_C(0xcbf29ce484222325))
+#define CLUI_CACHE_FNV_PRIME  (UINT64_C(0x100000001b3))
+
+/*
+ * Parsing result: key holds arguments the result was computed from, stored
+ * one after the other along with their terminating NULL bytes.
+ */
+struct clui_cache_slot {
+	uint64_t                    hash;
+	const struct clui_opt_set * set;
+	const struct clui_cmd *     cmd;
+	int                         argc;
+	int                         ret;
+	size_t                      len;
+	char *                      key;
+};
+
+/*
+ * Direct mapped cache. Each slot owns 2 contexts into ctxs: the one given
+ * to parsing, then the one parsing resulted in.
+ */
+struct clui_cache {
+	size_t                   ctx_size;
+	unsigned int             mask;
+	struct clui_cache_slot * slots;
+	char *                   ctxs;
+};
+
+static uint64_t
+clui_cache_hash(uint64_t hash, const void * data, size_t size)
+{
+	const unsigned char * byte = data;
+	size_t                b;
+
+	for (b = 0; b < size; b++)
+		hash = (hash ^ byte[b]) * CLUI_CACHE_FNV_PRIME;
+
+	return hash;
+}
+
+static uint64_t
+clui_cache_hash_args(const struct clui_cache * cache,
+                     int                       argc,
+                     char * const *            argv,
+                     const void *              ctx,
+                     size_t *                  len)
+{
+	uint64_t hash = CLUI_CACHE_FNV_OFFSET;
+	int      a;
+
+	*len = 0;
+	for (a = 0; a < argc; a++) {
+		size_t sz = strlen(argv[a]) + 1;
+
+		hash = clui_cache_hash(hash, argv[a], sz);
+		*len += sz;
+	}
+
+	return clui_cache_hash(hash, ctx, cache->ctx_size);
+}
+
+static char *
+clui_cache_slot_ctx(const struct clui_cache *      cache,
+                    const struct clui_cache_slot * slot,
+                    bool                           result)
+{
+	size_t s = (size_t)(slot - cache->slots);
+
+	return &cache->ctxs[((2 * s) + result) * cache->ctx_size];
+}
+
+static bool
+clui_cache_match(const struct clui_cache *      cache,
+                 const struct clui_cache_slot * slot,
+                 uint64_t                       hash,
+                 const struct clui_opt_set *    set,
+                 const struct clui_cmd *        cmd,
+                 int                            argc,
+                 char * const *                 argv,
+                 size_t                         len,
+                 const void *                   ctx)
+{
+	const char * key = slot->key;
+	int          a;
+
+	if (!key ||
+	    (slot->hash != hash) ||
+	    (slot->set != set) ||
+	    (slot->cmd != cmd) ||
+	    (slot->argc != argc) ||
+	    (slot->len != len))
+		return false;
+
+	for (a = 0; a < argc; a++) {
+		size_t sz = strlen(argv[a]) + 1;
+
+		if (memcmp(key, argv[a], sz))
+			return false;
+		key += sz;
+	}
+
+	return !memcmp(clui_cache_slot_ctx(cache, slot, false),
+	               ctx,
+	               cache->ctx_size);
+}
+
+static void
+clui_cache_store(struct clui_cache *         cache,
+                 struct clui_cache_slot *    slot,
+                 uint64_t                    hash,
+                 const struct clui_opt_set * set,
+                 const struct clui_cmd *     cmd,
+                 int                         argc,
+                 char * const *              argv,
+                 size_t                      len,
+                 int                         ret,
+                 const void *                ctx)
+{
+	char * key;
+	int    a;
+
+	key = clui_mem_alloc(CLUI_MEM_RUN_SYS, len);
+	if (!key)
+		/* Just don't cache. */
+		return;
+
+	slot->hash = hash;
+	slot->set = set;
+	slot->cmd = cmd;
+	slot->argc = argc;
+	slot->ret = ret;
+	slot->len = len;
+	slot->key = key;
+
+	for (a = 0; a < argc; a++)
+		key = stpcpy(key, argv[a]) + 1;
+
+	memcpy(clui_cache_slot_ctx(cache, slot, true), ctx, cache->ctx_size);
+}
+
+int __clui_nonull(1, 2, 6, 7)
+clui_cache_parse(struct clui_cache *         cache,
+                 struct clui_parser *        parser,
+                 const struct clui_opt_set * set,
+                 const struct clui_cmd *     cmd,
+                 int                         argc,
+                 char * const *              argv,
+                 void *                      ctx)
+{
+	clui_assert(cache);
+	clui_assert_parser(parser);
+	clui_assert(set || cmd);
+	clui_assert(argc);
+	clui_assert(argv);
+	clui_assert(ctx);
+
+	struct clui_cache_slot * slot;
+	uint64_t                 hash;
+	size_t                   len;
+	int                      ret;
+
+	hash = clui_cache_hash_args(cache, argc, argv, ctx, &len);
+	slot = &cache->slots[hash & cache->mask];
+
+	if (clui_cache_match(cache, slot, hash, set, cmd, argc, argv, len, ctx)) {
+		memcpy(ctx,
+		       clui_cache_slot_ctx(cache, slot, true),
+		       cache->ctx_size);
+
+		return slot->ret;
+	}
+
+	/* Evict slot content and save initial context for next lookups. */
+	clui_mem_free(CLUI_MEM_RUN_SYS, slot->key);
+	slot->key = NULL;
+	memcpy(clui_cache_slot_ctx(cache, slot, false), ctx, cache->ctx_size);
+
+	parser->cacheable = true;
+
+	ret = clui_parse(parser, set, cmd, argc, argv, ctx);
+	if ((ret >= 0) && parser->cacheable)
+		clui_cache_store(cache,
+		                 slot,
+		                 hash,
+		                 set,
+		                 cmd,
+		                 argc,
+		                 argv,
+		                 len,
+		                 ret,
+		                 ctx);
+
+	return ret;
+}
+
+struct clui_cache *
+clui_cache_create(size_t ctx_size, unsigned int nr)
+{
+	struct clui_cache * cache;
+	unsigned int        slots_nr = 1;
+
+	if (!ctx_size || !nr || (nr > (1U << 16))) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	while (slots_nr < nr)
+		slots_nr <<= 1;
+
+	cache = clui_mem_alloc(CLUI_MEM_RUN_SYS, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->slots = clui_mem_zalloc(CLUI_MEM_RUN_SYS,
+	                               slots_nr * sizeof(cache->slots[0]));
+	if (!cache->slots)
+		goto free_cache;
+
+	cache->ctxs = clui_mem_alloc(CLUI_MEM_RUN_SYS, 2 * slots_nr * ctx_size);
+	if (!cache->ctxs)
+		goto free_slots;
+
+	cache->ctx_size = ctx_size;
+	cache->mask = slots_nr - 1;
+
+	return cache;
+
+free_slots:
+	clui_mem_free(CLUI_MEM_RUN_SYS, cache->slots);
+free_cache:
+	clui_mem_free(CLUI_MEM_RUN_SYS, cache);
+
+	return NULL;
+}
+
+void __clui_nonull(1)
+clui_cache_destroy(struct clui_cache * cache)
+{
+	clui_assert(cache);
+
+	unsigned int s;
+
+	for (s = 0; s <= cache->mask; s++)
+		clui_mem_free(CLUI_MEM_RUN_SYS, cache->slots[s].key);
+
+	clui_mem_free(CLUI_MEM_RUN_SYS, cache->ctxs);
+	clui_mem_free(CLUI_MEM_RUN_SYS, cache->slots);
+	clui_mem_free(CLUI_MEM_RUN_SYS, cache);
+}
@@ -1,9 +1,11 @@
 #include <clui/clui.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 
 /******************************************************************************
  * Helpers
@@ -27,10 +29,211 @@ clui_err(const struct clui_parser *restrict parser,
 	putc('\n', stderr);
 }
 
+/*
+ * Match argument against a parameter label. Labels declared thanks to
+ * CLUI_KWORD_PARM() or CLUI_SWITCH_PARM() come with their length and hash
+ * precomputed so that most of them are discarded without comparing strings.
+ */
+static bool
+clui_match_label(const char   *label,
+                 unsigned int  len,
+                 unsigned int  hash,
+                 const char   *arg,
+                 size_t        arg_len,
+                 unsigned int  arg_hash)
+{
+	clui_assert(len || (strnlen(label, CLUI_LABEL_MAX) < CLUI_LABEL_MAX));
+	clui_assert(!len || (strlen(label) == len));
+
+	if (!len)
+		return !strncmp(label, arg, arg_len) && !label[arg_len];
+
+	return (len == arg_len) && (hash == arg_hash) &&
+	       !memcmp(label, arg, len);
+}
+
+/*
+ * Resolve argument given as an abbreviation of a parameter label, see
+ * clui_enable_abbrev(). Returns the index of the only label starting with
+ * argument, -ENOENT when there is none, or -ENOTUNIQ when there are several,
+ * in which case these are reported as candidates of the given parameter kind.
+ */
+static int
+clui_expand_label(const struct clui_parser *parser,
+                  const char               *kind,
+                  const char * const        labels[],
+                  unsigned int              nr,
+                  const char               *arg,
+                  size_t                    arg_len)
+{
+	char         cands[LINE_MAX];
+	size_t       sz = 0;
+	int          found = -ENOENT;
+	unsigned int p;
+
+	for (p = 0; p < nr; p++) {
+		int ret;
+
+		if (strncmp(labels[p], arg, arg_len))
+			continue;
+
+		if (found == -ENOENT) {
+			found = (int)p;
+			continue;
+		}
+
+		if (found >= 0) {
+			sz = (size_t)snprintf(cands,
+			                      sizeof(cands),
+			                      "'%s'",
+			                      labels[found]);
+			found = -ENOTUNIQ;
+		}
+
+		if (sz >= sizeof(cands))
+			continue;
+
+		ret = snprintf(&cands[sz],
+		               sizeof(cands) - sz,
+		               ", '%s'",
+		               labels[p]);
+		sz += (size_t)ret;
+	}
+
+	if (found == -ENOTUNIQ)
+		clui_err(parser,
+		         "ambiguous '%.*s' %s: %s.\n",
+		         (int)arg_len,
+		         arg,
+		         kind,
+		         cands);
+
+	return found;
+}
+
+static int
+clui_lookup_kword_parm(const struct clui_parser             *parser,
+                       const struct clui_kword_parm * const  parms[],
+                       unsigned int                          nr,
+                       const char                           *arg,
+                       size_t                                len,
+                       unsigned int                          hash)
+{
+	unsigned int p;
+
+	for (p = 0; p < nr; p++) {
+		clui_assert(parms[p]);
+		clui_assert(parms[p]->label);
+
+		if (clui_match_label(parms[p]->label,
+		                     parms[p]->len,
+		                     parms[p]->hash,
+		                     arg,
+		                     len,
+		                     hash))
+			return (int)p;
+	}
+
+	if (parser->abbrev) {
+		const char *labels[nr];
+
+		for (p = 0; p < nr; p++)
+			labels[p] = parms[p]->label;
+
+		return clui_expand_label(parser,
+		                         "keyword",
+		                         labels,
+		                         nr,
+		                         arg,
+		                         len);
+	}
+
+	return -ENOENT;
+}
+
+static int
+clui_lookup_switch_parm(const struct clui_parser              *parser,
+                        const struct clui_switch_parm * const  parms[],
+                        unsigned int                           nr,
+                        const char                            *arg,
+                        size_t                                 len,
+                        unsigned int                           hash)
+{
+	unsigned int p;
+
+	for (p = 0; p < nr; p++) {
+		clui_assert(parms[p]);
+		clui_assert(parms[p]->label);
+		clui_assert(parms[p]->parse);
+
+		if (clui_match_label(parms[p]->label,
+		                     parms[p]->len,
+		                     parms[p]->hash,
+		                     arg,
+		                     len,
+		                     hash))
+			return (int)p;
+	}
+
+	if (parser->abbrev) {
+		const char *labels[nr];
+
+		for (p = 0; p < nr; p++)
+			labels[p] = parms[p]->label;
+
+		return clui_expand_label(parser,
+		                         "switch",
+		                         labels,
+		                         nr,
+		                         arg,
+		                         len);
+	}
+
+	return -ENOENT;
+}
+
 /******************************************************************************
  * Keyword parameter handling
  ******************************************************************************/
 
+static const struct clui_kword_parm *
+clui_find_kword_parm(const struct clui_cmd                *cmd,
+                     struct clui_parser                   *parser,
+                     const struct clui_kword_parm * const  parms[],
+                     unsigned int                          nr,
+                     int                                   argc,
+                     char * const                          argv[])
+{
+	size_t       len;
+	unsigned int hash;
+	int          p;
+
+	if ((argc < 2) || !argv[0] || !*argv[0] || !argv[1] || !*argv[1]) {
+		clui_err(parser, "missing keyword and/or parameter.\n");
+		clui_help_cmd(cmd, parser, stderr);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* Seach for a keyword parameter matching the first given argument. */
+	hash = clui_hash_label(argv[0], &len);
+	p = clui_lookup_kword_parm(parser, parms, nr, argv[0], len, hash);
+	if (p >= 0)
+		/* Found it ! */
+		return parms[p];
+
+	/* No matching keyword parm found. */
+	if (p == -ENOENT)
+		clui_err(parser,
+		         "unknown '%.*s' keyword.\n",
+		         CLUI_LABEL_MAX - 1,
+		         argv[0]);
+	clui_help_cmd(cmd, parser, stderr);
+	errno = -p;
+
+	return NULL;
+}
+
 int __clui_nonull(1, 2, 3, 6)
 clui_parse_one_kword_parm(const struct clui_cmd                *cmd,
                           struct clui_parser                   *parser,
@@ -46,40 +249,14 @@ clui_parse_one_kword_parm(const struct clui_cmd                *cmd,
 	clui_assert(nr);
 	clui_assert(argv);
 
-	unsigned int                  p;
 	const struct clui_kword_parm *parm;
 	int                           ret;
 
-	if ((argc < 2) || !argv[0] || !*argv[0] || !argv[1] || !*argv[1]) {
-		clui_err(parser, "missing keyword and/or parameter.\n");
-		clui_help_cmd(cmd, parser, stderr);
-		return -EINVAL;
-	}
+	parm = clui_find_kword_parm(cmd, parser, parms, nr, argc, argv);
+	if (!parm)
+		return -errno;
 
-	/* Seach for a keyword parameter matching the first given argument. */
-	for (p = 0; p < nr; p++) {
-		parm = parms[p];
-
-		clui_assert(parm);
-		clui_assert(parm->label);
-		clui_assert(strnlen(parm->label, CLUI_LABEL_MAX) <
-		            CLUI_LABEL_MAX);
-		clui_assert(parm->parse);
-
-		if (!strcmp(parm->label, argv[0]))
-			/* Found it ! */
-			break;
-	}
-
-	if (p == nr) {
-		/* No matching keyword parm found. */
-		clui_err(parser,
-		         "unknown '%.*s' keyword.\n",
-		         CLUI_LABEL_MAX - 1,
-		         argv[0]);
-		clui_help_cmd(cmd, parser, stderr);
-		return -ENOENT;
-	}
+	clui_assert(parm->parse);
 
 	/* Run the keyword parameter registered parser. */
 	ret = parm->parse(cmd, parser, argv[1], ctx);
@@ -120,6 +297,61 @@ clui_parse_all_kword_parms(const struct clui_cmd                *cmd,
 	return 0;
 }
 
+int __clui_nonull(1, 2, 3, 6, 7)
+clui_commit_all_kword_parms(const struct clui_cmd                *cmd,
+                            struct clui_parser                   *parser,
+                            const struct clui_kword_parm * const  parms[],
+                            unsigned int                          nr,
+                            int                                   argc,
+                            char * const                          argv[],
+                            clui_commit_kword_parms_fn           *commit,
+                            void                                 *ctx)
+{
+	clui_assert_cmd(cmd);
+	clui_assert_parser(parser);
+	clui_assert(parms);
+	clui_assert(nr);
+	clui_assert(argc >= 0);
+	clui_assert(argv);
+	clui_assert(commit);
+
+	struct clui_kword_staged staged[CLUI_KWORD_STAGED_MAX];
+	struct clui_kword_stage  stage = { .nr = 0, .staged = staged };
+
+	if (argc > (int)(2 * CLUI_KWORD_STAGED_MAX)) {
+		clui_err(parser,
+		         "too many keyword parameters (%u max).\n",
+		         CLUI_KWORD_STAGED_MAX);
+		return -E2BIG;
+	}
+
+	do {
+		const struct clui_kword_parm *parm;
+
+		parm = clui_find_kword_parm(cmd, parser, parms, nr, argc, argv);
+		if (!parm)
+			return -errno;
+
+		if (parm->parse) {
+			int ret;
+
+			ret = parm->parse(cmd, parser, argv[1], ctx);
+			if (ret)
+				return ret;
+		}
+
+		staged[stage.nr].parm = parm;
+		staged[stage.nr].arg = argv[1];
+		stage.nr++;
+
+		argc -= 2;
+		argv = &argv[2];
+	} while (argc > 0);
+
+	/* All keywords are valid: apply them at once. */
+	return commit(cmd, parser, &stage, ctx);
+}
+
 /******************************************************************************
  * Switch parameter handling
  ******************************************************************************/
@@ -139,8 +371,10 @@ clui_parse_one_switch_parm(const struct clui_cmd                 *cmd,
 	clui_assert(nr);
 	clui_assert(argv);
 
-	unsigned int                   p;
 	const struct clui_switch_parm *parm;
+	size_t                         len;
+	unsigned int                   hash;
+	int                            p;
 	int                            ret;
 
 	if ((argc < 1) || !argv[0] || !*argv[0]) {
@@ -150,30 +384,21 @@ clui_parse_one_switch_parm(const struct clui_cmd                 *cmd,
 	}
 
 	/* Seach for a switch keyword matching the given argument. */
-	for (p = 0; p < nr; p++) {
-		parm = parms[p];
-
-		clui_assert(parm);
-		clui_assert(parm->label);
-		clui_assert(strnlen(parm->label, CLUI_LABEL_MAX) <
-		            CLUI_LABEL_MAX);
-		clui_assert(parm->parse);
-
-		if (!strcmp(parm->label, argv[0]))
-			/* Found it ! */
-			break;
-	}
-
-	if (p == nr) {
+	hash = clui_hash_label(argv[0], &len);
+	p = clui_lookup_switch_parm(parser, parms, nr, argv[0], len, hash);
+	if (p < 0) {
 		/* No matching switch keyword found. */
-		clui_err(parser,
-		         "unknown '%.*s' keyword.\n",
-		         CLUI_LABEL_MAX - 1,
-		         argv[0]);
+		if (p == -ENOENT)
+			clui_err(parser,
+			         "unknown '%.*s' keyword.\n",
+			         CLUI_LABEL_MAX - 1,
+			         argv[0]);
 		clui_help_cmd(cmd, parser, stderr);
-		return -ENOENT;
+		return p;
 	}
 
+	parm = parms[p];
+
 	/* Run the switch registered parser. */
 	ret = parm->parse(cmd, parser, ctx);
 	if (ret)
@@ -213,6 +438,214 @@ clui_parse_all_switch_parms(const struct clui_cmd                 *cmd,
 	return 0;
 }
 
+/******************************************************************************
+ * Argument sources
+ ******************************************************************************/
+
+int __clui_nonull(1, 2)
+clui_next_argv_arg(struct clui_arg_src *src, struct clui_arg *arg)
+{
+	clui_assert(src);
+	clui_assert(arg);
+
+	struct clui_argv_src *asrc = (struct clui_argv_src *)src;
+	const char           *str;
+
+	if (asrc->cur >= asrc->argc)
+		return -ENODATA;
+
+	str = asrc->argv[asrc->cur++];
+	clui_assert(str);
+
+	arg->str = str;
+	arg->len = strlen(str);
+	arg->nul = true;
+
+	return 0;
+}
+
+int __clui_nonull(1, 2)
+clui_next_buff_arg(struct clui_arg_src *src, struct clui_arg *arg)
+{
+	clui_assert(src);
+	clui_assert(arg);
+
+	struct clui_buff_src *bsrc = (struct clui_buff_src *)src;
+	size_t                pos = bsrc->pos;
+	size_t                end;
+
+	while ((pos < bsrc->len) &&
+	       (!bsrc->buff[pos] || isspace((unsigned char)bsrc->buff[pos])))
+		pos++;
+
+	if (pos == bsrc->len) {
+		bsrc->pos = pos;
+		return -ENODATA;
+	}
+
+	for (end = pos;
+	     (end < bsrc->len) &&
+	     bsrc->buff[end] &&
+	     !isspace((unsigned char)bsrc->buff[end]);
+	     end++)
+		;
+
+	arg->str = &bsrc->buff[pos];
+	arg->len = end - pos;
+	arg->nul = (end < bsrc->len) && !bsrc->buff[end];
+
+	bsrc->pos = end;
+
+	return 0;
+}
+
+static int
+clui_next_arg(struct clui_arg_src *src, struct clui_arg *arg)
+{
+	int ret;
+
+	ret = src->next(src, arg);
+	clui_assert(ret || arg->len);
+
+	return ret;
+}
+
+static unsigned int
+clui_hash_arg(const struct clui_arg *arg, size_t *len)
+{
+	unsigned int hash = 0;
+	unsigned int mult = 1;
+	size_t       l;
+
+	*len = (arg->len < CLUI_LABEL_MAX) ? arg->len : CLUI_LABEL_MAX;
+	for (l = 0; l < *len; l++) {
+		hash += (unsigned int)(unsigned char)arg->str[l] * mult;
+		mult *= CLUI_HASH_MULT;
+	}
+
+	return hash;
+}
+
+int __clui_nonull(1, 2, 3, 5)
+clui_parse_src_kword_parms(const struct clui_cmd                *cmd,
+                           struct clui_parser                   *parser,
+                           const struct clui_kword_parm * const  parms[],
+                           unsigned int                          nr,
+                           struct clui_arg_src                  *src,
+                           void                                 *ctx)
+{
+	clui_assert_cmd(cmd);
+	clui_assert_parser(parser);
+	clui_assert(parms);
+	clui_assert(nr);
+	clui_assert(src);
+	clui_assert(src->next);
+
+	struct clui_arg kword;
+	struct clui_arg val;
+	int             ret;
+
+	while (!(ret = clui_next_arg(src, &kword))) {
+		const struct clui_kword_parm *parm;
+		size_t                        len;
+		unsigned int                  hash;
+		int                           p;
+
+		ret = clui_next_arg(src, &val);
+		if (ret) {
+			if (ret != -ENODATA)
+				return ret;
+
+			clui_err(parser, "missing keyword and/or parameter.\n");
+			clui_help_cmd(cmd, parser, stderr);
+			return -EINVAL;
+		}
+
+		hash = clui_hash_arg(&kword, &len);
+		p = clui_lookup_kword_parm(parser, parms, nr, kword.str, len, hash);
+		if (p < 0) {
+			if (p == -ENOENT)
+				clui_err(parser,
+				         "unknown '%.*s' keyword.\n",
+				         (int)((kword.len < CLUI_LABEL_MAX) ?
+				               kword.len : (CLUI_LABEL_MAX - 1)),
+				         kword.str);
+			clui_help_cmd(cmd, parser, stderr);
+			return p;
+		}
+
+		parm = parms[p];
+		clui_assert(parm->parse);
+
+		if (val.nul)
+			ret = parm->parse(cmd, parser, val.str, ctx);
+		else {
+			/* Parse callbacks expect NULL terminated strings. */
+			if (val.len >= LINE_MAX)
+				return -E2BIG;
+
+			char str[val.len + 1];
+
+			memcpy(str, val.str, val.len);
+			str[val.len] = '\0';
+
+			ret = parm->parse(cmd, parser, str, ctx);
+		}
+		if (ret)
+			return ret;
+	}
+
+	return (ret == -ENODATA) ? 0 : ret;
+}
+
+int __clui_nonull(1, 2, 3, 5)
+clui_parse_src_switch_parms(const struct clui_cmd                 *cmd,
+                            struct clui_parser                    *parser,
+                            const struct clui_switch_parm * const  parms[],
+                            unsigned int                           nr,
+                            struct clui_arg_src                   *src,
+                            void                                  *ctx)
+{
+	clui_assert_cmd(cmd);
+	clui_assert_parser(parser);
+	clui_assert(parms);
+	clui_assert(nr);
+	clui_assert(src);
+	clui_assert(src->next);
+
+	struct clui_arg kword;
+	int             ret;
+
+	while (!(ret = clui_next_arg(src, &kword))) {
+		const struct clui_switch_parm *parm;
+		size_t                         len;
+		unsigned int                   hash;
+		int                            p;
+
+		hash = clui_hash_arg(&kword, &len);
+		p = clui_lookup_switch_parm(parser, parms, nr, kword.str, len, hash);
+		if (p < 0) {
+			if (p == -ENOENT)
+				clui_err(parser,
+				         "unknown '%.*s' keyword.\n",
+				         (int)((kword.len < CLUI_LABEL_MAX) ?
+				               kword.len : (CLUI_LABEL_MAX - 1)),
+				         kword.str);
+			clui_help_cmd(cmd, parser, stderr);
+			return p;
+		}
+
+		parm = parms[p];
+		clui_assert(parm->parse);
+
+		ret = parm->parse(cmd, parser, ctx);
+		if (ret)
+			return ret;
+	}
+
+	return (ret == -ENODATA) ? 0 : ret;
+}
+
 /******************************************************************************
  * Parser option handling
  ******************************************************************************/
@@ -246,6 +679,10 @@ clui_parse_opts(const struct clui_opt_set *set,
 	const struct clui_opt      *opt;
 	int                         ret;
 
+#if defined(CONFIG_CLUI_PARSE_CACHE)
+	parser->cacheable &= set->pure;
+#endif /* defined(CONFIG_CLUI_PARSE_CACHE) */
+
 	*s++ = ':';
 	for (o = 0; o < set->nr; o++) {
 		struct option *l = &long_opts[o];
@@ -321,7 +758,7 @@ err:
  * Top-level parser handling
  ******************************************************************************/
 
-int __clui_nonull(1, 2, 3, 5)
+int __clui_nonull(1, 5)
 clui_parse(struct clui_parser        *parser,
            const struct clui_opt_set *set,
            const struct clui_cmd     *cmd,
@@ -369,6 +806,50 @@ clui_init(struct clui_parser *restrict parser,
 
 	strncpy(parser->argv0, basename(argv[0]), sizeof(parser->argv0) - 1);
 	parser->argv0[sizeof(parser->argv0) - 1] = '\0';
+	parser->abbrev = false;
+#if defined(CONFIG_CLUI_PARSE_CACHE)
+	parser->cacheable = false;
+#endif /* defined(CONFIG_CLUI_PARSE_CACHE) */
 
 	return 0;
 }
+
+int __clui_nonull(1, 4, 6)
+clui_run(struct clui_parser *         parser,
+         const struct clui_opt_set *  set,
+         const struct clui_cmd *      cmd,
+         const struct clui_exec_ops * ops,
+         int                          argc,
+         char * const                 argv[],
+         void *                       data)
+{
+	clui_assert_parser(parser);
+	clui_assert(set || cmd);
+	clui_assert_exec_ops(ops);
+	clui_assert(argc);
+	clui_assert(argv);
+
+	/* Context lives onto the stack so that running commands never allocates. */
+	max_align_t ctx[(ops->ctx_size + sizeof(max_align_t) - 1) /
+	                sizeof(max_align_t)];
+	int         ret;
+
+	memset(ctx, 0, sizeof(ctx));
+
+	if (ops->init) {
+		ret = ops->init(ctx, data);
+		if (ret)
+			return ret;
+	}
+
+	/* getopt_long() relies upon global state. */
+	optind = 0;
+	ret = clui_parse(parser, set, cmd, argc, argv, ctx);
+	if (!ret)
+		ret = ops->exec(ctx, data);
+
+	if (ops->fini)
+		ops->fini(ctx, data);
+
+	return ret;
+}
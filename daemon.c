@@ -0,0 +1,703 @@
+#include <clui/daemon.h>
+#include "mem_priv.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio_ext.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define CLUI_DAEMON_MAGIC   (0x636c7569U)
+#define CLUI_DAEMON_VERSION (1U)
+
+/* Maximum size of requests, header included. */
+#define CLUI_DAEMON_MSG_MAX (65536U)
+
+/* Descriptors passed along with requests: stdin, stdout, stderr and cwd. */
+#define CLUI_DAEMON_FD_NR   (4U)
+
+/*
+ * Request header, followed by argc arguments then envc "NAME=value" strings,
+ * NULL terminated.
+ */
+struct clui_daemon_req {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t argc;
+	uint32_t envc;
+};
+
+struct clui_daemon_rep {
+	int32_t status;
+};
+
+/* Server side state saved before running a request. */
+struct clui_daemon_saved {
+	int fds[CLUI_DAEMON_FD_NR];
+};
+
+/* Forwarded environment variable along with the value it replaces. */
+struct clui_daemon_env {
+	const char * name;
+	char *       old;
+	bool         set;
+};
+
+static int
+clui_daemon_addr(struct sockaddr_un * addr, const char * path)
+{
+	size_t len = strlen(path);
+
+	if (!len || (len >= sizeof(addr->sun_path)))
+		return -ENAMETOOLONG;
+
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path, path, len + 1);
+
+	return 0;
+}
+
+/******************************************************************************
+ * Client side
+ ******************************************************************************/
+
+static ssize_t
+clui_daemon_push(char * msg, size_t len, const char * str)
+{
+	size_t sz = strlen(str) + 1;
+
+	if ((len + sz) > CLUI_DAEMON_MSG_MAX)
+		return -E2BIG;
+
+	memcpy(&msg[len], str, sz);
+
+	return (ssize_t)(len + sz);
+}
+
+static ssize_t
+clui_daemon_push_env(char * msg, size_t len, const char * name)
+{
+	const char * val;
+	size_t       nlen;
+	size_t       vlen;
+
+	val = getenv(name);
+	if (!val)
+		return (ssize_t)len;
+
+	nlen = strlen(name);
+	vlen = strlen(val);
+	if ((len + nlen + 1 + vlen + 1) > CLUI_DAEMON_MSG_MAX)
+		return -E2BIG;
+
+	memcpy(&msg[len], name, nlen);
+	msg[len + nlen] = '=';
+	memcpy(&msg[len + nlen + 1], val, vlen + 1);
+
+	return (ssize_t)(len + nlen + 1 + vlen + 1);
+}
+
+static ssize_t
+clui_daemon_build_req(char *             msg,
+                      int                argc,
+                      char * const       argv[],
+                      const char * const env[])
+{
+	struct clui_daemon_req * req = (struct clui_daemon_req *)msg;
+	ssize_t                  len = sizeof(*req);
+	int                      a;
+
+	req->magic = CLUI_DAEMON_MAGIC;
+	req->version = CLUI_DAEMON_VERSION;
+	req->argc = (uint32_t)argc;
+	req->envc = 0;
+
+	for (a = 0; a < argc; a++) {
+		len = clui_daemon_push(msg, (size_t)len, argv[a]);
+		if (len < 0)
+			return len;
+	}
+
+	for (; env && *env; env++) {
+		ssize_t ret;
+
+		ret = clui_daemon_push_env(msg, (size_t)len, *env);
+		if (ret < 0)
+			return ret;
+
+		req->envc += (ret != len);
+		len = ret;
+	}
+
+	return len;
+}
+
+/*
+ * Only exchange with processes running under the same user: the client hands
+ * its standard streams and working directory over to the daemon.
+ */
+static bool
+clui_daemon_trusted(int sk)
+{
+	struct ucred cred;
+	socklen_t    len = sizeof(cred);
+
+	if (getsockopt(sk, SOL_SOCKET, SO_PEERCRED, &cred, &len))
+		return false;
+
+	return cred.uid == geteuid();
+}
+
+static int
+clui_daemon_send_req(int sk, const char * msg, size_t len)
+{
+	union {
+		char           buff[CMSG_SPACE(CLUI_DAEMON_FD_NR * sizeof(int))];
+		struct cmsghdr align;
+	}               ctrl;
+	struct iovec    iov = { .iov_base = (void *)msg, .iov_len = len };
+	struct msghdr   hdr = {
+		.msg_iov        = &iov,
+		.msg_iovlen     = 1,
+		.msg_control    = ctrl.buff,
+		.msg_controllen = sizeof(ctrl.buff)
+	};
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&hdr);
+	int             fds[CLUI_DAEMON_FD_NR] = {
+		STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, -1
+	};
+	ssize_t         ret;
+
+	fds[3] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (fds[3] < 0)
+		return -errno;
+
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	do {
+		ret = sendmsg(sk, &hdr, MSG_NOSIGNAL);
+	} while ((ret < 0) && (errno == EINTR));
+
+	close(fds[3]);
+
+	if (ret < 0)
+		return -errno;
+
+	return 0;
+}
+
+int __clui_nonull(1, 3, 5)
+clui_daemon_call(const char *         path,
+                 int                  argc,
+                 char * const         argv[],
+                 const char * const   env[],
+                 int *                status)
+{
+	clui_assert(path);
+	clui_assert(argc > 0);
+	clui_assert(argv);
+	clui_assert(status);
+
+	struct sockaddr_un     addr;
+	char *                 msg;
+	ssize_t                len;
+	int                    sk;
+	struct clui_daemon_rep rep;
+	int                    ret;
+
+	ret = clui_daemon_addr(&addr, path);
+	if (ret)
+		return ret;
+
+	msg = clui_mem_alloc(CLUI_MEM_RUN_SYS, CLUI_DAEMON_MSG_MAX);
+	if (!msg)
+		return -errno;
+
+	len = clui_daemon_build_req(msg, argc, argv, env);
+	if (len < 0) {
+		ret = (int)len;
+		goto free;
+	}
+
+	sk = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sk < 0) {
+		ret = -errno;
+		goto free;
+	}
+
+	if (connect(sk, (const struct sockaddr *)&addr, sizeof(addr))) {
+		ret = -errno;
+		goto close;
+	}
+
+	/* Don't hand descriptors over to whoever managed to create path. */
+	if (!clui_daemon_trusted(sk)) {
+		ret = -EPERM;
+		goto close;
+	}
+
+	ret = clui_daemon_send_req(sk, msg, (size_t)len);
+	if (ret)
+		goto close;
+
+	do {
+		len = recv(sk, &rep, sizeof(rep), 0);
+	} while ((len < 0) && (errno == EINTR));
+
+	if (len < 0)
+		ret = -errno;
+	else if (len != sizeof(rep))
+		/* Daemon went away while running the command. */
+		ret = -ECONNRESET;
+	else
+		*status = rep.status;
+
+close:
+	close(sk);
+free:
+	clui_mem_free(CLUI_MEM_RUN_SYS, msg);
+
+	return ret;
+}
+
+/******************************************************************************
+ * Server side
+ ******************************************************************************/
+
+/*
+ * Remove the socket file at path when left behind by an instance which is
+ * gone, i.e. nothing accepts connections onto it anymore. Any other file,
+ * including the socket of a running instance, is left untouched.
+ */
+static int
+clui_daemon_reclaim(const char * path, const struct sockaddr_un * addr)
+{
+	struct stat st;
+	int         sk;
+	int         err;
+
+	if (lstat(path, &st))
+		return (errno == ENOENT) ? 0 : -errno;
+
+	if (!S_ISSOCK(st.st_mode))
+		return -EADDRINUSE;
+
+	sk = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sk < 0)
+		return -errno;
+
+	err = connect(sk, (const struct sockaddr *)addr, sizeof(*addr)) ?
+	      errno : 0;
+	close(sk);
+
+	if (err != ECONNREFUSED)
+		return -EADDRINUSE;
+
+	if (unlink(path) && (errno != ENOENT))
+		return -errno;
+
+	return 0;
+}
+
+static int
+clui_daemon_listen(const char * path)
+{
+	struct sockaddr_un addr;
+	int                sk;
+	int                err;
+
+	err = clui_daemon_addr(&addr, path);
+	if (err)
+		return err;
+
+	err = clui_daemon_reclaim(path, &addr);
+	if (err)
+		return err;
+
+	sk = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sk < 0)
+		return -errno;
+
+	if (bind(sk, (const struct sockaddr *)&addr, sizeof(addr)) ||
+	    chmod(path, S_IRUSR | S_IWUSR) ||
+	    listen(sk, SOMAXCONN)) {
+		err = -errno;
+		close(sk);
+		return err;
+	}
+
+	return sk;
+}
+
+static int
+clui_daemon_recv_req(int sk, char * msg, int fds[CLUI_DAEMON_FD_NR])
+{
+	union {
+		char           buff[CMSG_SPACE(CLUI_DAEMON_FD_NR * sizeof(int))];
+		struct cmsghdr align;
+	}               ctrl;
+	struct iovec    iov = { .iov_base = msg, .iov_len = CLUI_DAEMON_MSG_MAX };
+	struct msghdr   hdr = {
+		.msg_iov        = &iov,
+		.msg_iovlen     = 1,
+		.msg_control    = ctrl.buff,
+		.msg_controllen = sizeof(ctrl.buff)
+	};
+	struct cmsghdr *cmsg;
+	ssize_t         len;
+	unsigned int    f;
+
+	do {
+		len = recvmsg(sk, &hdr, MSG_CMSG_CLOEXEC);
+	} while ((len < 0) && (errno == EINTR));
+
+	if (len < 0)
+		return -errno;
+
+	cmsg = CMSG_FIRSTHDR(&hdr);
+	if (!cmsg ||
+	    (cmsg->cmsg_level != SOL_SOCKET) ||
+	    (cmsg->cmsg_type != SCM_RIGHTS))
+		return -EPROTO;
+
+	if (cmsg->cmsg_len != CMSG_LEN(CLUI_DAEMON_FD_NR * sizeof(int))) {
+		/* Do not leak descriptors of malformed requests. */
+		for (f = 0;
+		     f < ((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+		     f++)
+			close(((int *)CMSG_DATA(cmsg))[f]);
+		return -EPROTO;
+	}
+
+	memcpy(fds, CMSG_DATA(cmsg), CLUI_DAEMON_FD_NR * sizeof(int));
+
+	if ((hdr.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ||
+	    ((size_t)len < sizeof(struct clui_daemon_req)) ||
+	    msg[len - 1]) {
+		for (f = 0; f < CLUI_DAEMON_FD_NR; f++)
+			close(fds[f]);
+		return -EPROTO;
+	}
+
+	return (int)len;
+}
+
+/*
+ * Split request strings into argv and env arrays. Returns a single
+ * allocated array holding both, NULL terminated.
+ */
+static char **
+clui_daemon_parse_req(char * msg, size_t len)
+{
+	const struct clui_daemon_req * req = (struct clui_daemon_req *)msg;
+	char *                         str = &msg[sizeof(*req)];
+	const char *                   end = &msg[len];
+	char **                        args;
+	size_t                         nr;
+	size_t                         a;
+
+	if ((req->magic != CLUI_DAEMON_MAGIC) ||
+	    (req->version != CLUI_DAEMON_VERSION) ||
+	    !req->argc)
+		return NULL;
+
+	nr = (size_t)req->argc + req->envc;
+	if (nr > (len - sizeof(*req)))
+		return NULL;
+
+	args = clui_mem_alloc(CLUI_MEM_RUN_SYS, (nr + 2) * sizeof(args[0]));
+	if (!args)
+		return NULL;
+
+	for (a = 0; a < nr; a++) {
+		if (str >= end)
+			goto free;
+
+		if ((a >= req->argc) && !strchr(str, '='))
+			goto free;
+
+		args[a + (a >= req->argc)] = str;
+		str += strlen(str) + 1;
+	}
+
+	if (str != end)
+		goto free;
+
+	args[req->argc] = NULL;
+	args[nr + 1] = NULL;
+
+	return args;
+
+free:
+	clui_mem_free(CLUI_MEM_RUN_SYS, args);
+
+	return NULL;
+}
+
+static int
+clui_daemon_install(const int                        fds[CLUI_DAEMON_FD_NR],
+                    const struct clui_daemon_saved * saved)
+{
+	int f;
+	int err;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (f = 0; f < 3; f++) {
+		if (dup2(fds[f], f) < 0)
+			goto restore;
+	}
+
+	if (fchdir(fds[3]))
+		goto restore;
+
+	/* Drop input buffered from the previous stdin. */
+	__fpurge(stdin);
+	clearerr(stdin);
+	clearerr(stdout);
+	clearerr(stderr);
+
+	return 0;
+
+restore:
+	err = -errno;
+
+	while (f--)
+		dup2(saved->fds[f], f);
+
+	return err;
+}
+
+static void
+clui_daemon_restore(const struct clui_daemon_saved * saved)
+{
+	int f;
+	int ret __unused;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (f = 0; f < 3; f++)
+		dup2(saved->fds[f], f);
+
+	ret = fchdir(saved->fds[3]);
+	clui_assert(!ret);
+
+	/* Drop input the command left buffered from its client. */
+	__fpurge(stdin);
+	clearerr(stdin);
+	clearerr(stdout);
+	clearerr(stderr);
+}
+
+static void
+clui_daemon_set_env(struct clui_daemon_env * vars, char * env[])
+{
+	for (; *env; env++, vars++) {
+		char *       eq = strchr(*env, '=');
+		const char * old;
+
+		*eq = '\0';
+		vars->name = *env;
+
+		old = getenv(vars->name);
+		if (old) {
+			vars->old = clui_mem_strndup(CLUI_MEM_RUN_SYS,
+			                             old,
+			                             strlen(old));
+			if (!vars->old)
+				/* Would not be able to restore it. */
+				continue;
+		}
+
+		vars->set = !setenv(vars->name, eq + 1, 1);
+	}
+}
+
+static void
+clui_daemon_unset_env(struct clui_daemon_env * vars, unsigned int nr)
+{
+	unsigned int v = nr;
+
+	/*
+	 * Restore in reverse order so that a name forwarded more than once
+	 * gets the value it had before the first occurrence was set.
+	 */
+	while (v--) {
+		if (vars[v].set) {
+			if (vars[v].old)
+				setenv(vars[v].name, vars[v].old, 1);
+			else
+				unsetenv(vars[v].name);
+		}
+
+		clui_mem_free(CLUI_MEM_RUN_SYS, vars[v].old);
+	}
+}
+
+static int
+clui_daemon_run(const struct clui_opt_set *  set,
+                const struct clui_cmd *      cmd,
+                const struct clui_exec_ops * ops,
+                int                          argc,
+                char * const                 argv[],
+                void *                       data)
+{
+	struct clui_parser parser;
+	int                ret;
+
+	ret = clui_init(&parser, argc, argv);
+	if (ret)
+		return ret;
+
+	return clui_run(&parser, set, cmd, ops, argc, argv, data);
+}
+
+static void
+clui_daemon_serve_one(int                              sk,
+                      char *                           msg,
+                      const struct clui_daemon_saved * saved,
+                      const struct clui_opt_set *      set,
+                      const struct clui_cmd *          cmd,
+                      const struct clui_exec_ops *     ops,
+                      void *                           data)
+{
+	const struct clui_daemon_req * req = (struct clui_daemon_req *)msg;
+	int                            fds[CLUI_DAEMON_FD_NR];
+	int                            len;
+	char **                        args;
+	struct clui_daemon_env *       vars;
+	struct clui_daemon_rep         rep;
+	unsigned int                   f;
+
+	len = clui_daemon_recv_req(sk, msg, fds);
+	if (len < 0)
+		return;
+
+	args = clui_daemon_parse_req(msg, (size_t)len);
+	if (!args)
+		goto close;
+
+	vars = clui_mem_zalloc(CLUI_MEM_RUN_SYS, req->envc * sizeof(vars[0]));
+	if (!vars && req->envc)
+		goto free;
+
+	rep.status = clui_daemon_install(fds, saved);
+	if (!rep.status) {
+		clui_daemon_set_env(vars, &args[req->argc + 1]);
+
+		rep.status = clui_daemon_run(set,
+		                             cmd,
+		                             ops,
+		                             (int)req->argc,
+		                             args,
+		                             data);
+
+		clui_daemon_unset_env(vars, req->envc);
+		clui_daemon_restore(saved);
+	}
+
+	send(sk, &rep, sizeof(rep), MSG_NOSIGNAL);
+
+	clui_mem_free(CLUI_MEM_RUN_SYS, vars);
+free:
+	clui_mem_free(CLUI_MEM_RUN_SYS, args);
+close:
+	for (f = 0; f < CLUI_DAEMON_FD_NR; f++)
+		close(fds[f]);
+}
+
+int __clui_nonull(3, 4)
+clui_daemon_serve(const struct clui_opt_set *  set,
+                  const struct clui_cmd *      cmd,
+                  const struct clui_exec_ops * ops,
+                  const char *                 path,
+                  void *                       data)
+{
+	clui_assert(set || cmd);
+	clui_assert_exec_ops(ops);
+	clui_assert(path);
+
+	struct clui_daemon_saved saved;
+	struct sigaction         act = { .sa_handler = SIG_IGN };
+	struct sigaction         old;
+	char *                   msg;
+	int                      lsk;
+	int                      f;
+	int                      ret;
+
+	/*
+	 * A client going away while its command still writes to the output
+	 * it forwarded would otherwise kill the daemon. Writes fail with
+	 * EPIPE instead.
+	 */
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGPIPE, &act, &old);
+
+	for (f = 0; f < 3; f++) {
+		saved.fds[f] = fcntl(f, F_DUPFD_CLOEXEC, CLUI_DAEMON_FD_NR);
+		if (saved.fds[f] < 0) {
+			ret = -errno;
+			goto close;
+		}
+	}
+
+	saved.fds[3] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+	if (saved.fds[3] < 0) {
+		ret = -errno;
+		goto close;
+	}
+	f++;
+
+	msg = clui_mem_alloc(CLUI_MEM_RUN_SYS, CLUI_DAEMON_MSG_MAX);
+	if (!msg) {
+		ret = -errno;
+		goto close;
+	}
+
+	lsk = clui_daemon_listen(path);
+	if (lsk < 0) {
+		ret = lsk;
+		goto free;
+	}
+
+	while (true) {
+		int sk;
+
+		sk = accept4(lsk, NULL, NULL, SOCK_CLOEXEC);
+		if (sk < 0) {
+			if ((errno == ECONNABORTED) || (errno == EPROTO))
+				continue;
+			ret = -errno;
+			break;
+		}
+
+		if (clui_daemon_trusted(sk))
+			clui_daemon_serve_one(sk, msg, &saved, set, cmd, ops,
+			                      data);
+
+		close(sk);
+	}
+
+	close(lsk);
+	unlink(path);
+free:
+	clui_mem_free(CLUI_MEM_RUN_SYS, msg);
+close:
+	while (f--)
+		close(saved.fds[f]);
+
+	sigaction(SIGPIPE, &old, NULL);
+
+	return ret;
+}
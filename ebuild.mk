@@ -3,14 +3,57 @@ config-h            := clui/config.h
 
 solibs             := libclui.so
 libclui.so-objs     = clui.o
+libclui.so-objs    += $(call kconf_enabled,CLUI_MEM_STATS,mem.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_BATCH,batch.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_PLUGIN,plugin.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_PARSE_CACHE,cache.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_DAEMON,daemon.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_APROPOS,apropos.o)
 libclui.so-objs    += $(call kconf_enabled,CLUI_SHELL,shell.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_SHELL_BULK_PASTE,paste.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_SHELL_PATH,path.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_SHELL_RECORD,record.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_SHELL_JOBS,job.o)
+libclui.so-objs    += $(call kconf_enabled,CLUI_SHELL_TIME,time.o)
 libclui.so-cflags  := $(EXTRA_CFLAGS) -Wall -Wextra -D_GNU_SOURCE -DPIC -fpic
 libclui.so-ldflags  = $(EXTRA_LDFLAGS) -shared -fpic -Wl,-soname,libclui.so \
-                      $(call kconf_enabled,CLUI_SHELL,-lreadline)
+                      $(call kconf_enabled,CLUI_SHELL,-lreadline) \
+                      $(call kconf_enabled,CLUI_SHELL_LAZY_HIST,-lpthread) \
+                      $(call kconf_enabled,CLUI_SHELL_JOBS,-lpthread) \
+                      $(call kconf_enabled,CLUI_BATCH,-lpthread) \
+                      $(call kconf_enabled,CLUI_PLUGIN,-ldl)
 libclui.so-pkgconf  = $(call kconf_enabled,CLUI_ASSERT,libutils)
 
+bins                = $(call kconf_enabled,CLUI_SHELL_RECORD,clui-replay)
+clui-replay-objs    = tools/replay.o tools/common.o
+clui-replay-cflags := $(EXTRA_CFLAGS) -Wall -Wextra -D_GNU_SOURCE
+clui-replay-ldflags = $(EXTRA_LDFLAGS) -lutil
+
+bins               += $(call kconf_enabled,CLUI_BENCH,clui-bench)
+clui-bench-objs     = tools/bench.o tools/common.o
+clui-bench-cflags  := $(EXTRA_CFLAGS) -Wall -Wextra -D_GNU_SOURCE
+clui-bench-ldflags  = $(EXTRA_LDFLAGS) -lutil
+
+bins               += $(call kconf_enabled,CLUI_BENCH,clui-bench-shell)
+clui-bench-shell-objs     = tools/bench_shell.o
+clui-bench-shell-cflags  := $(EXTRA_CFLAGS) -Wall -Wextra -D_GNU_SOURCE \
+                            -I$(HEADERDIR)
+clui-bench-shell-ldflags  = $(EXTRA_LDFLAGS) -L$(BUILDDIR) -lclui -lreadline
+
+bins               += $(call kconf_enabled,CLUI_SHELL_TEST,clui-test-shell)
+clui-test-shell-objs      = tools/test_shell.o
+clui-test-shell-cflags   := $(EXTRA_CFLAGS) -Wall -Wextra -D_GNU_SOURCE \
+                            -I$(HEADERDIR)
+clui-test-shell-ldflags   = $(EXTRA_LDFLAGS) -L$(BUILDDIR) -lclui -lreadline
+
 HEADERDIR          := $(CURDIR)/include
 headers             = clui/clui.h
+headers            += $(call kconf_enabled,CLUI_MEM_STATS,clui/mem.h)
+headers            += $(call kconf_enabled,CLUI_BATCH,clui/batch.h)
+headers            += $(call kconf_enabled,CLUI_PLUGIN,clui/plugin.h)
+headers            += $(call kconf_enabled,CLUI_PARSE_CACHE,clui/cache.h)
+headers            += $(call kconf_enabled,CLUI_DAEMON,clui/daemon.h)
+headers            += $(call kconf_enabled,CLUI_APROPOS,clui/apropos.h)
 headers            += $(call kconf_enabled,CLUI_SHELL,clui/shell.h)
 
 define libclui_pkgconf_tmpl
@@ -24,7 +67,7 @@ Description: Command Line User Interface library
 Version: %%PKG_VERSION%%
 Requires: $(call kconf_enabled,CLUI_ASSERT,libutils)
 Cflags: -I$${includedir}
-Libs: -L$${libdir} -lclui $(call kconf_enabled,CLUI_SHELL,-lreadline)
+Libs: -L$${libdir} -lclui $(call kconf_enabled,CLUI_SHELL,-lreadline) $(call kconf_enabled,CLUI_SHELL_LAZY_HIST,-lpthread) $(call kconf_enabled,CLUI_SHELL_JOBS,-lpthread) $(call kconf_enabled,CLUI_BATCH,-lpthread) $(call kconf_enabled,CLUI_PLUGIN,-ldl)
 endef
 
 pkgconfigs         := libclui.pc
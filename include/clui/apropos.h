@@ -0,0 +1,81 @@
+#ifndef _CLUI_APROPOS_H
+#define _CLUI_APROPOS_H
+
+#include <clui/clui.h>
+
+/*
+ * Command searchable thanks to clui_apropos_search().
+ * kwords optionally points to the labels of keywords the command accepts,
+ * which are given more weight than words of its help text.
+ */
+struct clui_apropos_entry {
+	const char *            label;
+	const struct clui_cmd * cmd;
+	const char * const *    kwords;
+	unsigned int            kwords_nr;
+};
+
+#define clui_assert_apropos_entry(_entry) \
+	clui_assert(_entry); \
+	clui_assert((_entry)->label); \
+	clui_assert(*(_entry)->label); \
+	clui_assert_cmd((_entry)->cmd); \
+	clui_assert(!(_entry)->kwords_nr || (_entry)->kwords)
+
+struct clui_apropos_index;
+
+struct clui_apropos {
+	const struct clui_apropos_entry * entries;
+	unsigned int                      nr;
+	struct clui_apropos_index *       index;
+};
+
+#define CLUI_APROPOS_INIT(_entries, _nr) \
+	{ .entries = _entries, .nr = _nr, .index = NULL }
+
+#define clui_assert_apropos(_apropos) \
+	clui_assert(_apropos); \
+	clui_assert((_apropos)->entries); \
+	clui_assert((_apropos)->nr)
+
+struct clui_apropos_hit {
+	const struct clui_apropos_entry * entry;
+	unsigned int                      score;
+};
+
+/*
+ * Search commands whose label, keywords or help text contain words starting
+ * with each of the words given into query.
+ * Up to nr best ranked commands are stored into hits, in decreasing score
+ * order. Returns the total number of matching commands or a negative errno.
+ *
+ * The index is built upon first call by rendering the help of every command
+ * into memory, and must be released using clui_apropos_fini().
+ */
+extern int
+clui_apropos_search(struct clui_apropos *      apropos,
+                    const struct clui_parser * parser,
+                    const char *               query,
+                    struct clui_apropos_hit    hits[],
+                    unsigned int               nr) __clui_nonull(1, 2, 3);
+
+/*
+ * Save index into a file that clui_apropos_load() maps in memory, so that it
+ * is shared among processes and built only once. The file is bound to the
+ * commands table given to CLUI_APROPOS_INIT(): loading it using another
+ * table fails with -ESTALE. It should be saved again whenever help texts
+ * change.
+ */
+extern int
+clui_apropos_save(struct clui_apropos *      apropos,
+                  const struct clui_parser * parser,
+                  const char *               path) __clui_nonull(1, 2, 3);
+
+extern int
+clui_apropos_load(struct clui_apropos * apropos, const char * path)
+	__clui_nonull(1, 2);
+
+extern void
+clui_apropos_fini(struct clui_apropos * apropos) __clui_nonull(1);
+
+#endif /* _CLUI_APROPOS_H */
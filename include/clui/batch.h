@@ -0,0 +1,45 @@
+#ifndef _CLUI_BATCH_H
+#define _CLUI_BATCH_H
+
+#include <clui/clui.h>
+#include <limits.h>
+
+/*
+ * Group identifier of commands that must run alone, i.e. once all commands
+ * preceding it have completed and before any command following it starts.
+ */
+#define CLUI_BATCH_BARRIER (UINT_MAX)
+
+typedef int (clui_batch_init_fn)(void * ctx, void * data);
+
+typedef unsigned int (clui_batch_group_fn)(const void * ctx, void * data);
+
+typedef int (clui_batch_exec_fn)(void * ctx, FILE * stdio, void * data);
+
+typedef void (clui_batch_fini_fn)(void * ctx, void * data);
+
+struct clui_batch_ops {
+	size_t                ctx_size;
+	clui_batch_init_fn *  init;
+	clui_batch_group_fn * group;
+	clui_batch_exec_fn *  exec;
+	clui_batch_fini_fn *  fini;
+};
+
+#define clui_assert_batch_ops(_ops) \
+	clui_assert(_ops); \
+	clui_assert((_ops)->ctx_size); \
+	clui_assert((_ops)->exec)
+
+extern int
+clui_batch_run(struct clui_parser *          parser,
+               const struct clui_opt_set *   set,
+               const struct clui_cmd *       cmd,
+               const struct clui_batch_ops * ops,
+               FILE *                        script,
+               FILE *                        stdio,
+               unsigned int                  workers,
+               void *                        data)
+	__clui_nonull(1, 4, 5, 6);
+
+#endif /* _CLUI_BATCH_H */
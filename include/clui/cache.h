@@ -0,0 +1,36 @@
+#ifndef _CLUI_CACHE_H
+#define _CLUI_CACHE_H
+
+#include <clui/clui.h>
+
+struct clui_cache;
+
+/*
+ * Parse given arguments the same way clui_parse() does, replaying results of
+ * a previous call given identical arguments, option set, command and initial
+ * context content instead of parsing them again.
+ * Results are recorded only when parsing succeeded and went through pure
+ * option set and commands only, see struct clui_opt_set and struct clui_cmd.
+ * Sub-commands must be dispatched using clui_parse_cmd() for their purity to
+ * be accounted for.
+ */
+extern int
+clui_cache_parse(struct clui_cache *         cache,
+                 struct clui_parser *        parser,
+                 const struct clui_opt_set * set,
+                 const struct clui_cmd *     cmd,
+                 int                         argc,
+                 char * const *              argv,
+                 void *                      ctx) __clui_nonull(1, 2, 6, 7);
+
+/*
+ * Create a cache of nr parsing results, nr being rounded up to the next
+ * power of 2, for contexts of ctx_size bytes.
+ */
+extern struct clui_cache *
+clui_cache_create(size_t ctx_size, unsigned int nr);
+
+extern void
+clui_cache_destroy(struct clui_cache * cache) __clui_nonull(1);
+
+#endif /* _CLUI_CACHE_H */
@@ -3,6 +3,7 @@
 
 #include <clui/config.h>
 #include <utils/cdefs.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <getopt.h>
 #include <linux/taskstats.h>
@@ -32,10 +33,631 @@
 
 #define CLUI_LABEL_MAX (32U)
 
+/******************************************************************************
+ * Build time validated table declarations
+ ******************************************************************************/
+
+/* Evaluates to 0, or breaks the build unless _expr holds. */
+#define CLUI_STATIC_CHECK(_expr, _msg) \
+	(0 * sizeof(struct { _Static_assert(_expr, _msg); int _dummy; }))
+
+#define CLUI_STATIC_CHECK_FN(_fn, _type) \
+	CLUI_STATIC_CHECK(_Generic((_fn), _type *: 1, default: 0), \
+	                  "invalid '" #_fn "' callback")
+
+/* CLUI_STATIC_CHECK_FN() counterpart accepting NULL optional callbacks. */
+#define CLUI_STATIC_CHECK_OPT_FN(_fn, _type) \
+	CLUI_STATIC_CHECK(_Generic((_fn), _type *: 1, void *: 1, default: 0), \
+	                  "invalid '" #_fn "' callback")
+
+/*
+ * Polynomial hash of labels, computable at build time out of string literals
+ * thanks to CLUI_LABEL_HASH(). Both must give the same results.
+ * clui_hash_label() also stores label length into len, hence it is not pure.
+ */
+#define CLUI_HASH_MULT (31U)
+
+static inline unsigned int __clui_nonull(1, 2)
+clui_hash_label(const char * label, size_t * len)
+{
+	unsigned int hash = 0;
+	unsigned int mult = 1;
+	size_t       l;
+
+	for (l = 0; label[l] && (l < CLUI_LABEL_MAX); l++) {
+		hash += (unsigned int)(unsigned char)label[l] * mult;
+		mult *= CLUI_HASH_MULT;
+	}
+
+	*len = l;
+
+	return hash;
+}
+
+#define _CLUI_MULT_0  (1U)
+#define _CLUI_MULT_1  (_CLUI_MULT_0 * CLUI_HASH_MULT)
+#define _CLUI_MULT_2  (_CLUI_MULT_1 * CLUI_HASH_MULT)
+#define _CLUI_MULT_3  (_CLUI_MULT_2 * CLUI_HASH_MULT)
+#define _CLUI_MULT_4  (_CLUI_MULT_3 * CLUI_HASH_MULT)
+#define _CLUI_MULT_5  (_CLUI_MULT_4 * CLUI_HASH_MULT)
+#define _CLUI_MULT_6  (_CLUI_MULT_5 * CLUI_HASH_MULT)
+#define _CLUI_MULT_7  (_CLUI_MULT_6 * CLUI_HASH_MULT)
+#define _CLUI_MULT_8  (_CLUI_MULT_7 * CLUI_HASH_MULT)
+#define _CLUI_MULT_9  (_CLUI_MULT_8 * CLUI_HASH_MULT)
+#define _CLUI_MULT_10 (_CLUI_MULT_9 * CLUI_HASH_MULT)
+#define _CLUI_MULT_11 (_CLUI_MULT_10 * CLUI_HASH_MULT)
+#define _CLUI_MULT_12 (_CLUI_MULT_11 * CLUI_HASH_MULT)
+#define _CLUI_MULT_13 (_CLUI_MULT_12 * CLUI_HASH_MULT)
+#define _CLUI_MULT_14 (_CLUI_MULT_13 * CLUI_HASH_MULT)
+#define _CLUI_MULT_15 (_CLUI_MULT_14 * CLUI_HASH_MULT)
+#define _CLUI_MULT_16 (_CLUI_MULT_15 * CLUI_HASH_MULT)
+#define _CLUI_MULT_17 (_CLUI_MULT_16 * CLUI_HASH_MULT)
+#define _CLUI_MULT_18 (_CLUI_MULT_17 * CLUI_HASH_MULT)
+#define _CLUI_MULT_19 (_CLUI_MULT_18 * CLUI_HASH_MULT)
+#define _CLUI_MULT_20 (_CLUI_MULT_19 * CLUI_HASH_MULT)
+#define _CLUI_MULT_21 (_CLUI_MULT_20 * CLUI_HASH_MULT)
+#define _CLUI_MULT_22 (_CLUI_MULT_21 * CLUI_HASH_MULT)
+#define _CLUI_MULT_23 (_CLUI_MULT_22 * CLUI_HASH_MULT)
+#define _CLUI_MULT_24 (_CLUI_MULT_23 * CLUI_HASH_MULT)
+#define _CLUI_MULT_25 (_CLUI_MULT_24 * CLUI_HASH_MULT)
+#define _CLUI_MULT_26 (_CLUI_MULT_25 * CLUI_HASH_MULT)
+#define _CLUI_MULT_27 (_CLUI_MULT_26 * CLUI_HASH_MULT)
+#define _CLUI_MULT_28 (_CLUI_MULT_27 * CLUI_HASH_MULT)
+#define _CLUI_MULT_29 (_CLUI_MULT_28 * CLUI_HASH_MULT)
+#define _CLUI_MULT_30 (_CLUI_MULT_29 * CLUI_HASH_MULT)
+
+#define _CLUI_HASH_CHAR(_label, _idx) \
+	(((_idx) < (sizeof(_label) - 1)) ? \
+	 ((unsigned int)(unsigned char)(_label)[(_idx) % sizeof(_label)] * \
+	  _CLUI_MULT_ ## _idx) : \
+	 0U)
+
+#define CLUI_LABEL_HASH(_label) \
+	(_CLUI_HASH_CHAR(_label, 0) + _CLUI_HASH_CHAR(_label, 1) + \
+	 _CLUI_HASH_CHAR(_label, 2) + _CLUI_HASH_CHAR(_label, 3) + \
+	 _CLUI_HASH_CHAR(_label, 4) + _CLUI_HASH_CHAR(_label, 5) + \
+	 _CLUI_HASH_CHAR(_label, 6) + _CLUI_HASH_CHAR(_label, 7) + \
+	 _CLUI_HASH_CHAR(_label, 8) + _CLUI_HASH_CHAR(_label, 9) + \
+	 _CLUI_HASH_CHAR(_label, 10) + _CLUI_HASH_CHAR(_label, 11) + \
+	 _CLUI_HASH_CHAR(_label, 12) + _CLUI_HASH_CHAR(_label, 13) + \
+	 _CLUI_HASH_CHAR(_label, 14) + _CLUI_HASH_CHAR(_label, 15) + \
+	 _CLUI_HASH_CHAR(_label, 16) + _CLUI_HASH_CHAR(_label, 17) + \
+	 _CLUI_HASH_CHAR(_label, 18) + _CLUI_HASH_CHAR(_label, 19) + \
+	 _CLUI_HASH_CHAR(_label, 20) + _CLUI_HASH_CHAR(_label, 21) + \
+	 _CLUI_HASH_CHAR(_label, 22) + _CLUI_HASH_CHAR(_label, 23) + \
+	 _CLUI_HASH_CHAR(_label, 24) + _CLUI_HASH_CHAR(_label, 25) + \
+	 _CLUI_HASH_CHAR(_label, 26) + _CLUI_HASH_CHAR(_label, 27) + \
+	 _CLUI_HASH_CHAR(_label, 28) + _CLUI_HASH_CHAR(_label, 29) + \
+	 _CLUI_HASH_CHAR(_label, 30))
+
+#define CLUI_STATIC_CHECK_LABEL(_label) \
+	(CLUI_STATIC_CHECK(sizeof("" _label "") > 1, \
+	                   "empty label " #_label) + \
+	 CLUI_STATIC_CHECK(sizeof(_label) <= CLUI_LABEL_MAX, \
+	                   "label " #_label " too long"))
+
+#define _CLUI_EACH(_fn, ...) \
+	_CLUI_CONCAT(_CLUI_EACH_, _CLUI_NARGS(__VA_ARGS__))(_fn, __VA_ARGS__)
+
+#define _CLUI_CONCAT(_first, _second) \
+	_CLUI_CONCAT_EXPAND(_first, _second)
+
+#define _CLUI_CONCAT_EXPAND(_first, _second) \
+	_first ## _second
+
+#define _CLUI_NARGS(...) \
+	_CLUI_NARGS_PICK(__VA_ARGS__, \
+	 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, \
+	 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, \
+	 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, \
+	 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, \
+	 6, 5, 4, 3, 2, 1)
+
+#define _CLUI_NARGS_PICK( \
+	_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+	_17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, \
+	_31, _32, _33, _34, _35, _36, _37, _38, _39, _40, _41, _42, _43, _44, \
+	_45, _46, _47, _48, _49, _50, _51, _52, _53, _54, _55, _56, _57, _58, \
+	_59, _60, _61, _62, _nr, ...) \
+	_nr
+
+#define _CLUI_EACH_1(_fn, _arg) _fn(_arg)
+#define _CLUI_EACH_2(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_1(_fn, __VA_ARGS__)
+#define _CLUI_EACH_3(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_2(_fn, __VA_ARGS__)
+#define _CLUI_EACH_4(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_3(_fn, __VA_ARGS__)
+#define _CLUI_EACH_5(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_4(_fn, __VA_ARGS__)
+#define _CLUI_EACH_6(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_5(_fn, __VA_ARGS__)
+#define _CLUI_EACH_7(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_6(_fn, __VA_ARGS__)
+#define _CLUI_EACH_8(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_7(_fn, __VA_ARGS__)
+#define _CLUI_EACH_9(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_8(_fn, __VA_ARGS__)
+#define _CLUI_EACH_10(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_9(_fn, __VA_ARGS__)
+#define _CLUI_EACH_11(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_10(_fn, __VA_ARGS__)
+#define _CLUI_EACH_12(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_11(_fn, __VA_ARGS__)
+#define _CLUI_EACH_13(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_12(_fn, __VA_ARGS__)
+#define _CLUI_EACH_14(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_13(_fn, __VA_ARGS__)
+#define _CLUI_EACH_15(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_14(_fn, __VA_ARGS__)
+#define _CLUI_EACH_16(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_15(_fn, __VA_ARGS__)
+#define _CLUI_EACH_17(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_16(_fn, __VA_ARGS__)
+#define _CLUI_EACH_18(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_17(_fn, __VA_ARGS__)
+#define _CLUI_EACH_19(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_18(_fn, __VA_ARGS__)
+#define _CLUI_EACH_20(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_19(_fn, __VA_ARGS__)
+#define _CLUI_EACH_21(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_20(_fn, __VA_ARGS__)
+#define _CLUI_EACH_22(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_21(_fn, __VA_ARGS__)
+#define _CLUI_EACH_23(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_22(_fn, __VA_ARGS__)
+#define _CLUI_EACH_24(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_23(_fn, __VA_ARGS__)
+#define _CLUI_EACH_25(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_24(_fn, __VA_ARGS__)
+#define _CLUI_EACH_26(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_25(_fn, __VA_ARGS__)
+#define _CLUI_EACH_27(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_26(_fn, __VA_ARGS__)
+#define _CLUI_EACH_28(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_27(_fn, __VA_ARGS__)
+#define _CLUI_EACH_29(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_28(_fn, __VA_ARGS__)
+#define _CLUI_EACH_30(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_29(_fn, __VA_ARGS__)
+#define _CLUI_EACH_31(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_30(_fn, __VA_ARGS__)
+#define _CLUI_EACH_32(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_31(_fn, __VA_ARGS__)
+#define _CLUI_EACH_33(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_32(_fn, __VA_ARGS__)
+#define _CLUI_EACH_34(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_33(_fn, __VA_ARGS__)
+#define _CLUI_EACH_35(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_34(_fn, __VA_ARGS__)
+#define _CLUI_EACH_36(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_35(_fn, __VA_ARGS__)
+#define _CLUI_EACH_37(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_36(_fn, __VA_ARGS__)
+#define _CLUI_EACH_38(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_37(_fn, __VA_ARGS__)
+#define _CLUI_EACH_39(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_38(_fn, __VA_ARGS__)
+#define _CLUI_EACH_40(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_39(_fn, __VA_ARGS__)
+#define _CLUI_EACH_41(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_40(_fn, __VA_ARGS__)
+#define _CLUI_EACH_42(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_41(_fn, __VA_ARGS__)
+#define _CLUI_EACH_43(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_42(_fn, __VA_ARGS__)
+#define _CLUI_EACH_44(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_43(_fn, __VA_ARGS__)
+#define _CLUI_EACH_45(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_44(_fn, __VA_ARGS__)
+#define _CLUI_EACH_46(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_45(_fn, __VA_ARGS__)
+#define _CLUI_EACH_47(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_46(_fn, __VA_ARGS__)
+#define _CLUI_EACH_48(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_47(_fn, __VA_ARGS__)
+#define _CLUI_EACH_49(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_48(_fn, __VA_ARGS__)
+#define _CLUI_EACH_50(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_49(_fn, __VA_ARGS__)
+#define _CLUI_EACH_51(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_50(_fn, __VA_ARGS__)
+#define _CLUI_EACH_52(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_51(_fn, __VA_ARGS__)
+#define _CLUI_EACH_53(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_52(_fn, __VA_ARGS__)
+#define _CLUI_EACH_54(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_53(_fn, __VA_ARGS__)
+#define _CLUI_EACH_55(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_54(_fn, __VA_ARGS__)
+#define _CLUI_EACH_56(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_55(_fn, __VA_ARGS__)
+#define _CLUI_EACH_57(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_56(_fn, __VA_ARGS__)
+#define _CLUI_EACH_58(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_57(_fn, __VA_ARGS__)
+#define _CLUI_EACH_59(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_58(_fn, __VA_ARGS__)
+#define _CLUI_EACH_60(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_59(_fn, __VA_ARGS__)
+#define _CLUI_EACH_61(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_60(_fn, __VA_ARGS__)
+#define _CLUI_EACH_62(_fn, _arg, ...) \
+	_fn(_arg) _CLUI_EACH_61(_fn, __VA_ARGS__)
+
+/*
+ * Apply _fn to _arg and each of the following arguments in turn, i.e.
+ * _fn(_arg, _other), for all _other.
+ */
+#define _CLUI_EACH_WITH(_fn, _arg, ...) \
+	_CLUI_CONCAT(_CLUI_WITH_, _CLUI_NARGS(__VA_ARGS__))(_fn, \
+	                                                    _arg, \
+	                                                    __VA_ARGS__)
+
+#define _CLUI_WITH_1(_fn, _arg, _other) _fn(_arg, _other)
+#define _CLUI_WITH_2(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_1(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_3(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_2(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_4(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_3(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_5(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_4(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_6(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_5(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_7(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_6(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_8(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_7(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_9(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_8(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_10(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_9(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_11(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_10(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_12(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_11(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_13(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_12(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_14(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_13(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_15(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_14(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_16(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_15(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_17(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_16(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_18(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_17(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_19(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_18(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_20(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_19(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_21(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_20(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_22(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_21(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_23(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_22(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_24(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_23(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_25(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_24(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_26(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_25(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_27(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_26(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_28(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_27(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_29(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_28(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_30(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_29(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_31(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_30(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_32(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_31(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_33(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_32(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_34(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_33(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_35(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_34(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_36(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_35(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_37(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_36(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_38(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_37(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_39(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_38(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_40(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_39(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_41(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_40(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_42(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_41(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_43(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_42(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_44(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_43(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_45(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_44(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_46(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_45(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_47(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_46(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_48(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_47(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_49(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_48(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_50(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_49(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_51(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_50(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_52(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_51(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_53(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_52(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_54(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_53(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_55(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_54(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_56(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_55(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_57(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_56(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_58(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_57(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_59(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_58(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_60(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_59(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_61(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_60(_fn, _arg, __VA_ARGS__)
+#define _CLUI_WITH_62(_fn, _arg, _other, ...) \
+	_fn(_arg, _other) _CLUI_WITH_61(_fn, _arg, __VA_ARGS__)
+
+/*
+ * Apply _fn to each argument along with all arguments following it, i.e.
+ * _fn(_ctx, _arg, ...), and _last to the last argument, i.e.
+ * _last(_ctx, _arg). Combined with _CLUI_EACH_WITH(), this visits all pairs
+ * of arguments.
+ */
+#define _CLUI_EACH_REST(_fn, _last, _ctx, ...) \
+	_CLUI_CONCAT(_CLUI_REST_, _CLUI_NARGS(__VA_ARGS__))(_fn, \
+	                                                    _last, \
+	                                                    _ctx, \
+	                                                    __VA_ARGS__)
+
+#define _CLUI_REST_1(_fn, _last, _ctx, _arg) _last(_ctx, _arg)
+#define _CLUI_REST_2(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_1(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_3(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_2(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_4(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_3(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_5(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_4(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_6(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_5(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_7(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_6(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_8(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_7(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_9(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_8(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_10(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_9(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_11(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_10(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_12(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_11(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_13(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_12(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_14(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_13(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_15(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_14(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_16(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_15(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_17(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_16(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_18(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_17(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_19(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_18(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_20(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_19(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_21(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_20(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_22(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_21(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_23(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_22(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_24(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_23(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_25(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_24(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_26(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_25(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_27(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_26(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_28(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_27(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_29(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_28(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_30(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_29(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_31(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_30(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_32(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_31(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_33(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_32(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_34(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_33(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_35(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_34(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_36(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_35(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_37(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_36(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_38(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_37(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_39(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_38(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_40(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_39(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_41(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_40(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_42(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_41(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_43(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_42(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_44(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_43(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_45(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_44(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_46(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_45(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_47(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_46(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_48(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_47(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_49(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_48(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_50(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_49(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_51(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_50(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_52(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_51(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_53(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_52(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_54(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_53(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_55(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_54(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_56(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_55(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_57(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_56(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_58(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_57(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_59(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_58(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_60(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_59(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_61(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_60(_fn, _last, _ctx, __VA_ARGS__)
+#define _CLUI_REST_62(_fn, _last, _ctx, _arg, ...) \
+	_fn(_ctx, _arg, __VA_ARGS__) \
+	_CLUI_REST_61(_fn, _last, _ctx, __VA_ARGS__)
+
+/*
+ * Evaluates to 0 when _expr holds. Otherwise, breaks the build when used to
+ * initialize an object of static storage duration since a division by zero
+ * is not a constant. Unlike CLUI_STATIC_CHECK(), _expr need not be an integer
+ * constant expression, e.g. it may compare string literals characters.
+ */
+#define CLUI_STATIC_FOLD_CHECK(_expr) \
+	((1U / (unsigned int)!!(_expr)) - 1U)
+
+#define _CLUI_CHAR_DIFF(_a, _b, _idx) \
+	(((_idx) < sizeof(_a)) && \
+	 ((_a)[(_idx) % sizeof(_a)] != (_b)[(_idx) % sizeof(_b)]))
+
+/* Tells whether 2 string literal labels differ, at build time. */
+#define _CLUI_LABELS_DIFFER(_a, _b) \
+	((sizeof(_a) != sizeof(_b)) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 0) || _CLUI_CHAR_DIFF(_a, _b, 1) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 2) || _CLUI_CHAR_DIFF(_a, _b, 3) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 4) || _CLUI_CHAR_DIFF(_a, _b, 5) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 6) || _CLUI_CHAR_DIFF(_a, _b, 7) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 8) || _CLUI_CHAR_DIFF(_a, _b, 9) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 10) || _CLUI_CHAR_DIFF(_a, _b, 11) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 12) || _CLUI_CHAR_DIFF(_a, _b, 13) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 14) || _CLUI_CHAR_DIFF(_a, _b, 15) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 16) || _CLUI_CHAR_DIFF(_a, _b, 17) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 18) || _CLUI_CHAR_DIFF(_a, _b, 19) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 20) || _CLUI_CHAR_DIFF(_a, _b, 21) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 22) || _CLUI_CHAR_DIFF(_a, _b, 23) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 24) || _CLUI_CHAR_DIFF(_a, _b, 25) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 26) || _CLUI_CHAR_DIFF(_a, _b, 27) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 28) || _CLUI_CHAR_DIFF(_a, _b, 29) || \
+	 _CLUI_CHAR_DIFF(_a, _b, 30))
+
 struct clui_cmd;
 
 struct clui_parser {
 	char argv0[TS_COMM_LEN];
+	/* Accept unique prefixes of keyword and switch labels. */
+	bool abbrev;
+#if defined(CONFIG_CLUI_PARSE_CACHE)
+	/* Cleared when parsing goes through non pure commands or options. */
+	bool cacheable;
+#endif /* defined(CONFIG_CLUI_PARSE_CACHE) */
 };
 
 #define clui_assert_parser(_parser) \
@@ -43,6 +665,19 @@ struct clui_parser {
 	clui_assert(*(_parser)->argv0); \
 	clui_assert(!(_parser)->argv0[sizeof(parser->argv0) - 1])
 
+/*
+ * Have keyword and switch parameters looked up by unique prefix of their
+ * label when no label matches exactly, e.g. "mt 1500" for the "mtu" keyword
+ * of "set link eth0 mtu 1500". Command words themselves are not abbreviated.
+ * Ambiguous prefixes are rejected with -ENOTUNIQ and a message listing
+ * candidates.
+ */
+static inline void __clui_nonull(1)
+clui_enable_abbrev(struct clui_parser *parser, bool on)
+{
+	parser->abbrev = on;
+}
+
 /******************************************************************************
  * Keyword parameter handling
  ******************************************************************************/
@@ -55,8 +690,74 @@ typedef int (clui_parse_kword_parm_fn)(const struct clui_cmd *cmd,
 struct clui_kword_parm {
 	const char               *label;
 	clui_parse_kword_parm_fn *parse;
+	unsigned int              len;
+	unsigned int              hash;
 };
 
+#define _CLUI_KWORD_PARM(_label, _parse, _distinct) \
+	{ \
+		.label = _label, \
+		.parse = _parse, \
+		.len   = (sizeof(_label) - 1) + \
+		         CLUI_STATIC_CHECK_LABEL(_label) + \
+		         CLUI_STATIC_CHECK_OPT_FN(_parse, \
+		                                  clui_parse_kword_parm_fn) + \
+		         CLUI_STATIC_FOLD_CHECK(_distinct), \
+		.hash  = CLUI_LABEL_HASH(_label) \
+	}
+
+/*
+ * Keyword parameter initializer checking label and parse callback at build
+ * time. Precomputed label length and hash spare strcmp() calls at lookup
+ * time. Parameters built at runtime may compute them using
+ * clui_hash_label(), a null len meaning they are not available.
+ * parse may be NULL for keywords only given to clui_commit_all_kword_parms().
+ */
+#define CLUI_KWORD_PARM(_label, _parse) \
+	_CLUI_KWORD_PARM(_label, _parse, 1)
+
+#define _CLUI_PARM_LABEL(_label, _parse) _label
+#define _CLUI_PARM_PARSE(_label, _parse) _parse
+
+#define _CLUI_PARM_DIFFER(_parm, _other) \
+	&& _CLUI_LABELS_DIFFER(_CLUI_PARM_LABEL _parm, _CLUI_PARM_LABEL _other)
+
+/* Index of the parameter followed by _nr others in table _name. */
+#define _CLUI_PARM_IDX(_name, _nr) \
+	((sizeof(_name ## _parms) / sizeof(_name ## _parms[0])) - 1 - (_nr))
+
+#define _CLUI_PARM_REF_REST(_name, _parm, ...) \
+	&_name ## _parms[_CLUI_PARM_IDX(_name, _CLUI_NARGS(__VA_ARGS__))],
+#define _CLUI_PARM_REF_LAST(_name, _parm) \
+	&_name ## _parms[_CLUI_PARM_IDX(_name, 0)],
+
+#define _CLUI_KWORD_INIT_REST(_name, _parm, ...) \
+	_CLUI_KWORD_PARM(_CLUI_PARM_LABEL _parm, \
+	                 _CLUI_PARM_PARSE _parm, \
+	                 1 _CLUI_EACH_WITH(_CLUI_PARM_DIFFER, _parm, __VA_ARGS__)),
+#define _CLUI_KWORD_INIT_LAST(_name, _parm) \
+	CLUI_KWORD_PARM _parm,
+
+/*
+ * Define _name as a table of pointers to keyword parameters, along with the
+ * _name ## _parms array of parameters they point to, both static. Parameters
+ * are given as parenthesized CLUI_KWORD_PARM() arguments lists, i.e. (label,
+ * parse callback). Build fails when 2 parameters share the same label.
+ */
+#define CLUI_DEFINE_KWORD_PARMS(_name, ...) \
+	static const struct clui_kword_parm _name ## _parms[] = { \
+		_CLUI_EACH_REST(_CLUI_KWORD_INIT_REST, \
+		                _CLUI_KWORD_INIT_LAST, \
+		                _name, \
+		                __VA_ARGS__) \
+	}; \
+	static const struct clui_kword_parm * const _name[] = { \
+		_CLUI_EACH_REST(_CLUI_PARM_REF_REST, \
+		                _CLUI_PARM_REF_LAST, \
+		                _name, \
+		                __VA_ARGS__) \
+	}
+
 extern int
 clui_parse_one_kword_parm(
 	const struct clui_cmd                *cmd,
@@ -77,6 +778,49 @@ clui_parse_all_kword_parms(
         char * const                          argv[],
 	void                                 *ctx) __clui_nonull(1, 2, 3, 6);
 
+/*
+ * Maximum number of keyword parameters clui_commit_all_kword_parms() may stage
+ * from a single command line.
+ */
+#define CLUI_KWORD_STAGED_MAX (64U)
+
+/* Keyword parameter given onto the command line. */
+struct clui_kword_staged {
+	const struct clui_kword_parm *parm;
+	const char                   *arg;
+};
+
+/* Keyword parameters of a command line, in the order they were given. */
+struct clui_kword_stage {
+	unsigned int                    nr;
+	const struct clui_kword_staged *staged;
+};
+
+typedef int (clui_commit_kword_parms_fn)(const struct clui_cmd         *cmd,
+                                         struct clui_parser            *parser,
+                                         const struct clui_kword_stage *stage,
+                                         void                          *ctx);
+
+/*
+ * Parse all keyword parameters then hand them over to commit in a single
+ * call, so that they may be applied at once, e.g. within a single backend
+ * transaction. commit is not called unless all keywords are valid and their
+ * parse callbacks, which are optional here, succeeded. Its return value is
+ * returned.
+ * Returns -E2BIG when given more than CLUI_KWORD_STAGED_MAX keywords, -EINVAL
+ * when given none.
+ */
+extern int
+clui_commit_all_kword_parms(
+	const struct clui_cmd                *cmd,
+        struct clui_parser                   *parser,
+        const struct clui_kword_parm * const  parms[],
+        unsigned int                          nr,
+        int                                   argc,
+        char * const                          argv[],
+        clui_commit_kword_parms_fn           *commit,
+	void                                 *ctx) __clui_nonull(1, 2, 3, 6, 7);
+
 /******************************************************************************
  * Switch parameter handling
  ******************************************************************************/
@@ -88,8 +832,50 @@ typedef int (clui_parse_switch_parm_fn)(const struct clui_cmd *cmd,
 struct clui_switch_parm {
 	const char                *label;
 	clui_parse_switch_parm_fn *parse;
+	unsigned int               len;
+	unsigned int               hash;
 };
 
+#define _CLUI_SWITCH_PARM(_label, _parse, _distinct) \
+	{ \
+		.label = _label, \
+		.parse = _parse, \
+		.len   = (sizeof(_label) - 1) + \
+		         CLUI_STATIC_CHECK_LABEL(_label) + \
+		         CLUI_STATIC_CHECK_FN(_parse, \
+		                              clui_parse_switch_parm_fn) + \
+		         CLUI_STATIC_FOLD_CHECK(_distinct), \
+		.hash  = CLUI_LABEL_HASH(_label) \
+	}
+
+/* Switch parameter initializer, see CLUI_KWORD_PARM(). */
+#define CLUI_SWITCH_PARM(_label, _parse) \
+	_CLUI_SWITCH_PARM(_label, _parse, 1)
+
+#define _CLUI_SWITCH_INIT_REST(_name, _parm, ...) \
+	_CLUI_SWITCH_PARM(_CLUI_PARM_LABEL _parm, \
+	                  _CLUI_PARM_PARSE _parm, \
+	                  1 _CLUI_EACH_WITH(_CLUI_PARM_DIFFER, \
+	                                    _parm, \
+	                                    __VA_ARGS__)),
+#define _CLUI_SWITCH_INIT_LAST(_name, _parm) \
+	CLUI_SWITCH_PARM _parm,
+
+/* Switch parameter table definition, see CLUI_DEFINE_KWORD_PARMS(). */
+#define CLUI_DEFINE_SWITCH_PARMS(_name, ...) \
+	static const struct clui_switch_parm _name ## _parms[] = { \
+		_CLUI_EACH_REST(_CLUI_SWITCH_INIT_REST, \
+		                _CLUI_SWITCH_INIT_LAST, \
+		                _name, \
+		                __VA_ARGS__) \
+	}; \
+	static const struct clui_switch_parm * const _name[] = { \
+		_CLUI_EACH_REST(_CLUI_PARM_REF_REST, \
+		                _CLUI_PARM_REF_LAST, \
+		                _name, \
+		                __VA_ARGS__) \
+	}
+
 extern int
 clui_parse_one_switch_parm(
 	const struct clui_cmd                 *cmd,
@@ -110,6 +896,100 @@ clui_parse_all_switch_parms(
         char * const                           argv[],
 	void                                  *ctx) __clui_nonull(1, 2, 3, 6);
 
+/******************************************************************************
+ * Argument sources
+ ******************************************************************************/
+
+/*
+ * Argument given as a string view. nul tells whether str[len] is a NULL byte,
+ * in which case str may be used as is where a C string is expected.
+ */
+struct clui_arg {
+	const char * str;
+	size_t       len;
+	bool         nul;
+};
+
+struct clui_arg_src;
+
+/* Fetch next non-empty argument, returns -ENODATA when exhausted. */
+typedef int (clui_next_arg_fn)(struct clui_arg_src * src,
+                                struct clui_arg *     arg);
+
+/*
+ * Iterator over arguments, allowing to parse them straight out of streaming
+ * buffers. Sources embed it as their first field.
+ */
+struct clui_arg_src {
+	clui_next_arg_fn * next;
+};
+
+extern int
+clui_next_argv_arg(struct clui_arg_src * src, struct clui_arg * arg)
+	__clui_nonull(1, 2);
+
+/* Source iterating over an argv array. */
+struct clui_argv_src {
+	struct clui_arg_src src;
+	int                 argc;
+	char * const *      argv;
+	int                 cur;
+};
+
+#define CLUI_ARGV_SRC_INIT(_argc, _argv) \
+	{ \
+		.src  = { .next = clui_next_argv_arg }, \
+		.argc = _argc, \
+		.argv = _argv, \
+		.cur  = 0 \
+	}
+
+extern int
+clui_next_buff_arg(struct clui_arg_src * src, struct clui_arg * arg)
+	__clui_nonull(1, 2);
+
+/*
+ * Source iterating over arguments stored into a buffer and separated by
+ * blanks or NULL bytes, xargs style.
+ */
+struct clui_buff_src {
+	struct clui_arg_src src;
+	const char *        buff;
+	size_t              len;
+	size_t              pos;
+};
+
+#define CLUI_BUFF_SRC_INIT(_buff, _len) \
+	{ \
+		.src  = { .next = clui_next_buff_arg }, \
+		.buff = _buff, \
+		.len  = _len, \
+		.pos  = 0 \
+	}
+
+/*
+ * Parse all keyword parameters provided by src. Values not followed by a NULL
+ * byte are copied onto the stack before being given to parse callbacks and
+ * must be shorter than LINE_MAX.
+ */
+extern int
+clui_parse_src_kword_parms(
+	const struct clui_cmd                *cmd,
+        struct clui_parser                   *parser,
+        const struct clui_kword_parm * const  parms[],
+        unsigned int                          nr,
+        struct clui_arg_src                  *src,
+	void                                 *ctx) __clui_nonull(1, 2, 3, 5);
+
+extern int
+clui_parse_src_switch_parms(
+	const struct clui_cmd                 *cmd,
+        struct clui_parser                    *parser,
+        const struct clui_switch_parm * const  parms[],
+        unsigned int                           nr,
+        struct clui_arg_src                   *src,
+	void                                  *ctx) __clui_nonull(1, 2, 3, 5);
+
 /******************************************************************************
  * Parser option handling
  ******************************************************************************/
@@ -142,11 +1022,18 @@ typedef int (clui_check_opts_fn)(const struct clui_opt_set *set,
 typedef void (clui_help_opts_fn)(const struct clui_parser *parser,
                                  FILE                     *stdio);
 
+/*
+ * Option set or command may be declared pure when their parsing callbacks
+ * only store plain values into the parsing context, i.e. no pointers to
+ * arguments nor to allocated resources, so that parsing results may be
+ * replayed from a clui_cache.
+ */
 struct clui_opt_set {
 	unsigned int           nr;
 	const struct clui_opt *opts;
 	clui_check_opts_fn    *check;
 	clui_help_opts_fn     *help;
+	bool                   pure;
 };
 
 #define clui_assert_opt_set(_set) \
@@ -155,6 +1042,82 @@ struct clui_opt_set {
 	clui_assert((_set)->opts); \
 	clui_assert((_set)->help)
 
+/* Bit identifying alphanumeric short option characters, 0 otherwise. */
+#define _CLUI_OPT_BIT(_short) \
+	((((_short) >= '0') && ((_short) <= '9')) ? \
+	 (1ULL << (((_short) - '0') & 63)) : \
+	 (((_short) >= 'A') && ((_short) <= 'Z')) ? \
+	 (1ULL << (((_short) - 'A' + 10) & 63)) : \
+	 (((_short) >= 'a') && ((_short) <= 'z')) ? \
+	 (1ULL << (((_short) - 'a' + 36) & 63)) : \
+	 0ULL)
+
+/* Option initializer checking its fields at build time. */
+#define CLUI_OPT(_short, _long, _has_arg, _parse) \
+	{ \
+		.short_char = (_short) + \
+		              CLUI_STATIC_CHECK(_CLUI_OPT_BIT(_short), \
+		                                "invalid short option " \
+		                                #_short) + \
+		              CLUI_STATIC_CHECK(sizeof("" _long "") > 1, \
+		                                "empty long option") + \
+		              CLUI_STATIC_CHECK_FN(_parse, clui_parse_opt_fn), \
+		.long_name  = _long, \
+		.has_arg    = (_has_arg) + \
+		              CLUI_STATIC_CHECK( \
+		                      ((_has_arg) >= no_argument) && \
+		                      ((_has_arg) <= optional_argument), \
+		                      "invalid option argument mode"), \
+		.parse      = _parse \
+	}
+
+#define _CLUI_OPT_SHORT_BIT(_short, _long, _has_arg, _parse) \
+	_CLUI_OPT_BIT(_short)
+
+#define _CLUI_OPT_LONG(_short, _long, _has_arg, _parse) \
+	_long
+
+#define _CLUI_OPT_INIT(_opt)    CLUI_OPT _opt,
+#define _CLUI_OPT_BIT_SUM(_opt) + _CLUI_OPT_SHORT_BIT _opt
+#define _CLUI_OPT_BIT_OR(_opt)  | _CLUI_OPT_SHORT_BIT _opt
+
+#define _CLUI_OPT_DIFFER(_opt, _other) \
+	&& _CLUI_LABELS_DIFFER(_CLUI_OPT_LONG _opt, _CLUI_OPT_LONG _other)
+#define _CLUI_OPT_REST(_ctx, _opt, ...) \
+	_CLUI_EACH_WITH(_CLUI_OPT_DIFFER, _opt, __VA_ARGS__)
+#define _CLUI_OPT_LAST(_ctx, _opt)
+
+/*
+ * Option set initializer. Options are given as parenthesized CLUI_OPT()
+ * arguments lists, i.e. (short char, long name, argument mode, parse
+ * callback). Build fails when 2 options share the same short character:
+ * adding their bits then differs from or'ing them. It also fails when 2
+ * options share the same long name, provided the set has static storage
+ * duration, see CLUI_STATIC_FOLD_CHECK().
+ */
+#define CLUI_OPT_SET(_check, _help, _pure, ...) \
+	{ \
+		.nr    = _CLUI_NARGS(__VA_ARGS__) + \
+		         CLUI_STATIC_CHECK( \
+		                 (0ULL _CLUI_EACH(_CLUI_OPT_BIT_SUM, \
+		                                  __VA_ARGS__)) == \
+		                 (0ULL _CLUI_EACH(_CLUI_OPT_BIT_OR, \
+		                                  __VA_ARGS__)), \
+		                 "duplicate short option") + \
+		         CLUI_STATIC_FOLD_CHECK( \
+		                 1 _CLUI_EACH_REST(_CLUI_OPT_REST, \
+		                                   _CLUI_OPT_LAST, \
+		                                   , \
+		                                   __VA_ARGS__)) + \
+		         CLUI_STATIC_CHECK_FN(_help, clui_help_opts_fn), \
+		.opts  = (const struct clui_opt []) { \
+		                 _CLUI_EACH(_CLUI_OPT_INIT, __VA_ARGS__) \
+		         }, \
+		.check = _check, \
+		.help  = _help, \
+		.pure  = _pure \
+	}
+
 static inline void __clui_nonull(1, 2, 3)
 clui_help_opts(const struct clui_opt_set *set,
                const struct clui_parser  *parser,
@@ -191,6 +1154,7 @@ typedef void (clui_help_fn)(const struct clui_cmd    *cmd,
 struct clui_cmd {
 	clui_parse_fn *parse;
 	clui_help_fn  *help;
+	bool           pure;
 };
 
 #define clui_assert_cmd(_cmd) \
@@ -223,6 +1187,10 @@ clui_parse_cmd(const struct clui_cmd *cmd,
 	clui_assert_parser(parser);
 	clui_assert(argv);
 
+#if defined(CONFIG_CLUI_PARSE_CACHE)
+	parser->cacheable &= cmd->pure;
+#endif /* defined(CONFIG_CLUI_PARSE_CACHE) */
+
 	return cmd->parse(cmd, parser, argc, argv, ctx);
 }
 
@@ -241,7 +1209,7 @@ clui_parse(struct clui_parser        *parser,
            const struct clui_cmd     *cmd,
            int                        argc,
            char                      *const *argv,
-           void                      *ctx) __clui_nonull(1, 2, 3, 5);
+           void                      *ctx) __clui_nonull(1, 5);
 
 extern int
 clui_init(struct clui_parser *restrict parser,
@@ -250,4 +1218,43 @@ clui_init(struct clui_parser *restrict parser,
                                              __nothrow
                                              __leaf;
 
+typedef int (clui_init_ctx_fn)(void * ctx, void * data);
+
+typedef int (clui_exec_fn)(void * ctx, void * data);
+
+typedef void (clui_fini_ctx_fn)(void * ctx, void * data);
+
+/*
+ * Context life cycle of commands run by clui_run(). init and fini are
+ * optional.
+ */
+struct clui_exec_ops {
+	size_t             ctx_size;
+	clui_init_ctx_fn * init;
+	clui_exec_fn *     exec;
+	clui_fini_ctx_fn * fini;
+};
+
+#define clui_assert_exec_ops(_ops) \
+	clui_assert(_ops); \
+	clui_assert((_ops)->ctx_size); \
+	clui_assert((_ops)->exec)
+
+/*
+ * Parse the command line given by argc and argv as clui_parse() does into a
+ * zeroed context of ops->ctx_size bytes initialized by ops->init, then run
+ * ops->exec unless parsing failed. data is handed over to all ops.
+ * argv[0] is the program name, as for clui_parse(). The context is allocated
+ * onto the stack.
+ * Returns ops->exec return value, or a negative errno upon failure.
+ */
+extern int
+clui_run(struct clui_parser *         parser,
+         const struct clui_opt_set *  set,
+         const struct clui_cmd *      cmd,
+         const struct clui_exec_ops * ops,
+         int                          argc,
+         char * const                 argv[],
+         void *                       data) __clui_nonull(1, 4, 6);
+
 #endif /* _LIBCLUI_H */
@@ -0,0 +1,46 @@
+#ifndef _CLUI_DAEMON_H
+#define _CLUI_DAEMON_H
+
+#include <clui/clui.h>
+
+/*
+ * Serve command lines forwarded by clui_daemon_call() over the Unix socket
+ * bound to path, one at a time.
+ * For each of them, standard streams, working directory and forwarded
+ * environment variables of the calling process are installed, then the
+ * command line is run as clui_run() does. Its return value is handed back to
+ * the caller. Commands must not exit the process.
+ * SIGPIPE is ignored while serving so that a client going away while its
+ * command writes to forwarded output makes writes fail with EPIPE instead
+ * of killing the daemon.
+ * A socket file left at path by an instance which is gone is replaced.
+ *
+ * Returns a negative errno upon failure, -EADDRINUSE when path exists and is
+ * not a stale socket, e.g. when another instance serves it, -EINTR when
+ * interrupted by a signal.
+ */
+extern int
+clui_daemon_serve(const struct clui_opt_set *  set,
+                  const struct clui_cmd *      cmd,
+                  const struct clui_exec_ops * ops,
+                  const char *                 path,
+                  void *                       data)
+	__clui_nonull(3, 4);
+
+/*
+ * Have the command line given by argc and argv run by the daemon listening
+ * onto path. env is an optional NULL terminated list of names of environment
+ * variables to forward.
+ * Returns 0 and stores the command result into status once run, or a
+ * negative errno when the daemon cannot be reached, in which case the caller
+ * should run the command line by itself. Returns -EPERM when the process
+ * listening onto path runs under another user.
+ */
+extern int
+clui_daemon_call(const char *         path,
+                 int                  argc,
+                 char * const         argv[],
+                 const char * const   env[],
+                 int *                status) __clui_nonull(1, 3, 5);
+
+#endif /* _CLUI_DAEMON_H */
@@ -0,0 +1,58 @@
+#ifndef _CLUI_MEM_H
+#define _CLUI_MEM_H
+
+#include <clui/clui.h>
+
+/* Subsystems memory is accounted to. */
+enum clui_mem_sys {
+	/* Shell expression words and joined expression lines. */
+	CLUI_MEM_EXPR_SYS,
+	/* Completion candidates, matches and parameter sets. */
+	CLUI_MEM_CMPL_SYS,
+	/* History entries. */
+	CLUI_MEM_HIST_SYS,
+	/* Command runs: batch scripts, parse cache and daemon requests. */
+	CLUI_MEM_RUN_SYS,
+	CLUI_MEM_SYS_NR
+};
+
+/*
+ * Memory usage of a subsystem. live and peak are expressed in bytes as
+ * reported by malloc_usable_size(3).
+ * Memory handed over to readline, i.e. completion matches, is not accounted
+ * for past that point, except for history entries: these are walked upon
+ * query, which must then happen from the thread running the shell.
+ */
+struct clui_mem_stats {
+	size_t        live;
+	size_t        peak;
+	unsigned long allocs;
+	unsigned long frees;
+};
+
+extern void
+clui_mem_get_stats(enum clui_mem_sys sys, struct clui_mem_stats * stats)
+	__clui_nonull(2);
+
+/* Restart peak tracking from current usage, e.g. to measure an operation. */
+extern void
+clui_mem_reset_peak(enum clui_mem_sys sys);
+
+/*
+ * Number of allocations performed by the library from the calling thread
+ * so far, whatever the subsystem. Compare values read around a code path
+ * to assert it does not allocate.
+ */
+extern unsigned long
+clui_mem_thread_allocs(void);
+
+/*
+ * Hook run upon each allocation, from the allocating thread, e.g. to abort
+ * and get a backtrace when a path expected not to allocate does.
+ */
+typedef void (clui_mem_hook_fn)(enum clui_mem_sys sys, size_t size);
+
+extern void
+clui_mem_set_hook(clui_mem_hook_fn * hook);
+
+#endif /* _CLUI_MEM_H */
@@ -0,0 +1,141 @@
+#ifndef _CLUI_PLUGIN_H
+#define _CLUI_PLUGIN_H
+
+#include <clui/clui.h>
+#include <stdbool.h>
+
+/*
+ * Version of the interface between the library and plugin shared objects.
+ * Bump it whenever struct clui_plugin_desc layout changes.
+ */
+#define CLUI_PLUGIN_ABI (1U)
+
+typedef char ** (clui_plugin_complete_fn)(const char *       word,
+                                          size_t             len,
+                                          int                argc,
+                                          const char * const argv[],
+                                          void *             data);
+
+/* Descriptor exported by plugin shared objects. */
+struct clui_plugin_desc {
+	unsigned int              abi;
+	const struct clui_cmd *   cmd;
+	clui_plugin_complete_fn * complete;
+};
+
+#define CLUI_PLUGIN_DEFINE(_symbol, _cmd, _complete) \
+	const struct clui_plugin_desc _symbol \
+	__attribute__((visibility("default"))) = { \
+		.abi      = CLUI_PLUGIN_ABI, \
+		.cmd      = _cmd, \
+		.complete = _complete \
+	}
+
+struct clui_plugin_state {
+	void *                          handle;
+	const struct clui_plugin_desc * desc;
+};
+
+/*
+ * Lightweight command stub standing for a command implemented by a plugin
+ * shared object which is loaded upon first dispatch, help or completion
+ * request.
+ * The cmd field must remain the first one so that the stub may be given
+ * wherever a struct clui_cmd is expected.
+ */
+struct clui_plugin_cmd {
+	struct clui_cmd            cmd;
+	const char *               label;
+	const char *               summary;
+	const char * const *       hints;
+	unsigned int               hints_nr;
+	const char *               path;
+	const char *               symbol;
+	struct clui_plugin_state * state;
+};
+
+extern int
+clui_plugin_parse(const struct clui_cmd * cmd,
+                  struct clui_parser *    parser,
+                  int                     argc,
+                  char * const *          argv,
+                  void *                  ctx);
+
+extern void
+clui_plugin_help(const struct clui_cmd *    cmd,
+                 const struct clui_parser * parser,
+                 FILE *                     stdio);
+
+/*
+ * Define _name as a plugin command stub along with the state it loads its
+ * plugin into. Both have static storage duration so that the stub remains
+ * valid whatever the scope it is defined at.
+ */
+#define CLUI_PLUGIN_DEFINE_CMD(_name, \
+                               _label, \
+                               _summary, \
+                               _path, \
+                               _symbol, \
+                               _hints, \
+                               _hints_nr) \
+	static struct clui_plugin_state _name ## _state; \
+	static const struct clui_plugin_cmd _name = { \
+		.cmd      = { \
+			.parse = clui_plugin_parse, \
+			.help  = clui_plugin_help \
+		}, \
+		.label    = _label, \
+		.summary  = _summary, \
+		.hints    = _hints, \
+		.hints_nr = _hints_nr, \
+		.path     = _path, \
+		.symbol   = _symbol, \
+		.state    = &_name ## _state \
+	}
+
+#define clui_assert_plugin_cmd(_plug) \
+	clui_assert(_plug); \
+	clui_assert((_plug)->cmd.parse == clui_plugin_parse); \
+	clui_assert((_plug)->cmd.help == clui_plugin_help); \
+	clui_assert((_plug)->label); \
+	clui_assert(*(_plug)->label); \
+	clui_assert((_plug)->summary); \
+	clui_assert(!(_plug)->hints_nr || (_plug)->hints); \
+	clui_assert((_plug)->path); \
+	clui_assert((_plug)->symbol); \
+	clui_assert((_plug)->state)
+
+static inline const struct clui_plugin_cmd * __clui_nonull(1) __clui_pure
+clui_plugin_from_cmd(const struct clui_cmd * cmd)
+{
+	clui_assert(cmd);
+
+	return (const struct clui_plugin_cmd *)cmd;
+}
+
+/* Not pure: state is updated concurrently by loading threads. */
+static inline bool __clui_nonull(1)
+clui_plugin_loaded(const struct clui_plugin_cmd * plug)
+{
+	clui_assert_plugin_cmd(plug);
+
+	return !!__atomic_load_n(&plug->state->desc, __ATOMIC_ACQUIRE);
+}
+
+extern const struct clui_plugin_desc *
+clui_plugin_load(const struct clui_plugin_cmd * plug,
+                 const struct clui_parser *     parser) __clui_nonull(1);
+
+extern char **
+clui_plugin_complete(const struct clui_plugin_cmd * plug,
+                     const char *                   word,
+                     size_t                         len,
+                     int                            argc,
+                     const char * const             argv[],
+                     void *                         data)
+	__clui_nonull(1, 2);
+
+extern void
+clui_plugin_unload(const struct clui_plugin_cmd * plug) __clui_nonull(1);
+
+#endif /* _CLUI_PLUGIN_H */
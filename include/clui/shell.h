@@ -3,6 +3,7 @@
 
 #include <clui/clui.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <readline/readline.h>
 
 static inline void
@@ -11,6 +12,32 @@ clui_shell_inhibit_completion_char(void)
 	rl_completion_suppress_append = 1;
 }
 
+struct clui_shell_gen;
+
+typedef int (clui_shell_gen_fn)(struct clui_shell_gen * gen, void * data);
+
+extern int
+clui_shell_yield(struct clui_shell_gen * gen, const char * cand, size_t len)
+	__clui_nonull(1, 2);
+
+extern char **
+clui_shell_generate_matches(const char *        word,
+                            size_t              len,
+                            clui_shell_gen_fn * generate,
+                            void *              data) __clui_nonull(1, 3);
+
+extern void
+clui_shell_set_max_matches(unsigned int max);
+
+/*
+ * Enable matching candidates holding characters of the word to complete in
+ * order, not necessarily contiguous, instead of starting with it. Matches
+ * are then ordered by relevance, candidates starting with the word first.
+ * When their count exceeds the maximum, best ranked ones are retained.
+ */
+extern void
+clui_shell_set_fuzzy_matching(bool on);
+
 extern char **
 clui_shell_build_static_matches(const char *       word,
                                 size_t             len,
@@ -24,6 +51,7 @@ typedef char ** (clui_shell_build_kword_match_fn)(const char * word,
 struct clui_shell_kword_parm {
 	const struct clui_kword_parm    *clui;
 	clui_shell_build_kword_match_fn *build;
+	clui_shell_gen_fn               *gen;
 };
 
 extern char **
@@ -46,6 +74,62 @@ clui_shell_build_switch_matches(const char *                          word,
                                 const char * const                    argv[])
 	__clui_nonull(1, 3, 6);
 
+#if defined(CONFIG_CLUI_PLUGIN)
+
+#include <clui/plugin.h>
+
+extern char **
+clui_shell_build_plugin_matches(const struct clui_plugin_cmd * plug,
+                                const char *                   word,
+                                size_t                         len,
+                                int                            argc,
+                                const char * const             argv[],
+                                void *                         data)
+	__clui_nonull(1, 2);
+
+#endif /* defined(CONFIG_CLUI_PLUGIN) */
+
+#if defined(CONFIG_CLUI_SHELL_PATH)
+
+#define CLUI_SHELL_PATH_REG   (1U << 0)
+#define CLUI_SHELL_PATH_OTHER (1U << 1)
+#define CLUI_SHELL_PATH_FILES (CLUI_SHELL_PATH_REG | CLUI_SHELL_PATH_OTHER)
+
+/*
+ * Filter of file system path completion candidates.
+ * Directories are always completed, with a trailing slash, so that one may
+ * descend into them: give a null types mask to complete directories only.
+ * exts is an optional NULL terminated list of suffixes regular file names
+ * must end with.
+ */
+struct clui_shell_path_filter {
+	unsigned int         types;
+	const char * const * exts;
+};
+
+/*
+ * Completion candidates generator yielding paths of files found into the
+ * directory the word to complete refers to. data points to an optional
+ * struct clui_shell_path_filter.
+ * Directory listings are cached and reused as long as their modification
+ * time is left unchanged. Dot files are hidden unless the word to complete
+ * starts with a dot.
+ */
+extern int
+clui_shell_generate_paths(struct clui_shell_gen * gen, void * data)
+	__clui_nonull(1);
+
+extern char **
+clui_shell_build_path_matches(const char *                          word,
+                              size_t                                len,
+                              const struct clui_shell_path_filter * filter)
+	__clui_nonull(1);
+
+extern void
+clui_shell_clear_path_cache(void);
+
+#endif /* defined(CONFIG_CLUI_SHELL_PATH) */
+
 struct clui_shell_expr {
 	unsigned int  nr;
 	char **       words;
@@ -58,12 +142,77 @@ clui_shell_free_expr(const struct clui_shell_expr * expr) __nothrow __leaf;
 extern int
 clui_shell_read_expr(struct clui_shell_expr * expr) __clui_nonull(1);
 
+extern int
+clui_shell_run_builtin(const struct clui_shell_expr * expr) __clui_nonull(1);
+
+/*
+ * Run expr as a builtin when its first word names one. Otherwise, run the
+ * command line made of parser's program name followed by expr words as
+ * clui_run() does, so that set options and cmd are given all words.
+ * When the "time" prefix is enabled, see clui_shell_enable_time(), an
+ * expression prefixed with the "time" word has the command which follows
+ * run the same way, then timings are reported onto stderr.
+ */
+extern int
+clui_shell_exec_expr(struct clui_parser *           parser,
+                     const struct clui_opt_set *    set,
+                     const struct clui_cmd *        cmd,
+                     const struct clui_exec_ops *   ops,
+                     const struct clui_shell_expr * expr,
+                     void *                         data)
+	__clui_nonull(1, 4, 5);
+
+#if defined(CONFIG_CLUI_SHELL_TIME)
+
+/*
+ * Enable the "time" command prefix of clui_shell_exec_expr() and have
+ * completion skip it. Wall clock, CPU, parse and execute times, allocations
+ * performed by the library and bytes written by the calling thread are
+ * reported. Disabled by default so that "time" remains available as a
+ * command word.
+ */
+extern void
+clui_shell_enable_time(bool on);
+
+#endif /* defined(CONFIG_CLUI_SHELL_TIME) */
+
+/*
+ * Limit the number of bytes occupied by history lines, 0 meaning no limit.
+ * Oldest lines in excess are dropped. Whatever the limit, history holds a
+ * single copy of each line, the most recent one.
+ */
+extern void
+clui_shell_set_hist_size(size_t max);
+
 extern void
 clui_shell_shutdown(void) __nothrow __leaf;
 
 extern void
 clui_shell_redisplay(void) __nothrow __leaf;
 
+/*
+ * Print a message above the prompt from any thread without garbling the line
+ * being typed. Messages are queued then written out in batches by the thread
+ * running the shell, which redraws prompt and input line once per batch and
+ * at most CONFIG_CLUI_SHELL_PRINT_RATE times per second. A line feed is
+ * appended to messages lacking one. Messages queued while no prompt is shown
+ * are written out right before the next one.
+ * Return the number of bytes queued or -ENOBUFS when the queue is full, in
+ * which case the message is dropped and a count of dropped messages is
+ * printed with the next batch.
+ */
+extern int
+clui_shell_vprint(const char * format, va_list args)
+	__clui_nonull(1) __printf(1, 0);
+
+extern int
+clui_shell_print(const char * format, ...) __clui_nonull(1) __printf(1, 2);
+
+/*
+ * When built with CONFIG_CLUI_SHELL_STATIC, completion callbacks must return
+ * matches built by clui_shell_*_matches() helpers only, which are stored into
+ * static buffers instead of being allocated.
+ */
 typedef char ** (clui_shell_complete_fn)(const char *       word,
 					 size_t             match_len,
                                          int                argc,
@@ -80,4 +229,40 @@ clui_shell_init(const char * restrict    name,
 extern void
 clui_shell_fini(void);
 
+#if defined(CONFIG_CLUI_SHELL_RECORD)
+
+/*
+ * Record session input into the file at path, for clui-replay to replay.
+ * Input remains recorded when called before clui_shell_init(), although
+ * the session name and prompt are then missing from the recording: start
+ * recording past initialization to get them.
+ */
+extern int
+clui_shell_start_record(const char * path) __clui_nonull(1);
+
+extern void
+clui_shell_stop_record(void);
+
+#endif /* defined(CONFIG_CLUI_SHELL_RECORD) */
+
+#if defined(CONFIG_CLUI_SHELL_JOBS)
+
+struct clui_shell_job;
+
+typedef int (clui_shell_job_fn)(struct clui_shell_job * job, void * data);
+
+typedef void (clui_shell_release_job_fn)(void * data);
+
+extern bool
+clui_shell_job_cancelled(const struct clui_shell_job * job) __clui_nonull(1);
+
+extern int
+clui_shell_spawn_job(const struct clui_shell_expr * expr,
+                     clui_shell_job_fn *            run,
+                     clui_shell_release_job_fn *    release,
+                     void *                         data)
+	__clui_nonull(1, 2);
+
+#endif /* defined(CONFIG_CLUI_SHELL_JOBS) */
+
 #endif /* _CLUI_SHELL_H */
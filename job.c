@@ -0,0 +1,650 @@
+#include "shell_priv.h"
+#include "mem_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#define CLUI_SHELL_JOB_WORKERS CONFIG_CLUI_SHELL_JOB_WORKERS
+#define CLUI_SHELL_JOB_MAX     CONFIG_CLUI_SHELL_JOB_MAX
+
+enum clui_shell_job_state {
+	CLUI_SHELL_JOB_FREE = 0,
+	CLUI_SHELL_JOB_PENDING,
+	CLUI_SHELL_JOB_RUNNING,
+	CLUI_SHELL_JOB_DONE
+};
+
+struct clui_shell_job {
+	unsigned int                id;
+	enum clui_shell_job_state   state;
+	volatile sig_atomic_t       cancel;
+	int                         ret;
+	clui_shell_job_fn *         run;
+	clui_shell_release_job_fn * release;
+	void *                      data;
+	char *                      ln;
+	struct clui_shell_job *     next;
+};
+
+struct clui_shell_job_pool {
+	pthread_mutex_t         lock;
+	pthread_cond_t          todo;
+	pthread_cond_t          done;
+	struct clui_shell_job * head;
+	struct clui_shell_job * tail;
+	unsigned int            last_id;
+	unsigned int            workers_nr;
+	bool                    stop;
+	pthread_t               workers[CLUI_SHELL_JOB_WORKERS];
+	struct clui_shell_job   jobs[CLUI_SHELL_JOB_MAX];
+};
+
+static struct clui_shell_job_pool clui_the_jobs = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.todo = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER
+};
+
+bool __clui_nonull(1)
+clui_shell_job_cancelled(const struct clui_shell_job * job)
+{
+	clui_assert(job);
+	clui_assert(job->state == CLUI_SHELL_JOB_RUNNING);
+
+	return !!job->cancel;
+}
+
+static void
+clui_shell_release_job(struct clui_shell_job * job)
+{
+	clui_assert(job);
+
+	if (job->release)
+		job->release(job->data);
+}
+
+static void
+clui_shell_complete_job(struct clui_shell_job * job, int ret)
+{
+	clui_assert(job);
+
+	job->ret = ret;
+	job->state = CLUI_SHELL_JOB_DONE;
+
+	pthread_cond_broadcast(&clui_the_jobs.done);
+}
+
+static void *
+clui_shell_job_worker(void * arg __unused)
+{
+	pthread_mutex_lock(&clui_the_jobs.lock);
+
+	while (true) {
+		struct clui_shell_job * job;
+		int                     ret;
+
+		while (!clui_the_jobs.head && !clui_the_jobs.stop)
+			pthread_cond_wait(&clui_the_jobs.todo,
+			                  &clui_the_jobs.lock);
+
+		if (clui_the_jobs.stop)
+			break;
+
+		/* Dequeue oldest pending job. */
+		job = clui_the_jobs.head;
+		clui_the_jobs.head = job->next;
+		if (!clui_the_jobs.head)
+			clui_the_jobs.tail = NULL;
+
+		clui_assert(job->state == CLUI_SHELL_JOB_PENDING);
+		job->state = CLUI_SHELL_JOB_RUNNING;
+
+		pthread_mutex_unlock(&clui_the_jobs.lock);
+
+		ret = job->run(job, job->data);
+		clui_shell_release_job(job);
+
+		pthread_mutex_lock(&clui_the_jobs.lock);
+
+		clui_shell_complete_job(job, ret);
+
+		/*
+		 * Have the shell print completion notice along with next batch
+		 * of messages, preserving the line being typed.
+		 */
+		clui_shell_schedule_prints();
+	}
+
+	pthread_mutex_unlock(&clui_the_jobs.lock);
+
+	return NULL;
+}
+
+static int
+clui_shell_start_job_workers(void)
+{
+	while (clui_the_jobs.workers_nr < CLUI_SHELL_JOB_WORKERS) {
+		pthread_t * thr;
+		int         err;
+
+		thr = &clui_the_jobs.workers[clui_the_jobs.workers_nr];
+		err = pthread_create(thr, NULL, clui_shell_job_worker, NULL);
+		if (err)
+			/* Run with less workers if at least one is available. */
+			return clui_the_jobs.workers_nr ? 0 : -err;
+
+		clui_the_jobs.workers_nr++;
+	}
+
+	return 0;
+}
+
+static struct clui_shell_job *
+clui_shell_alloc_job(void)
+{
+	unsigned int j;
+
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++) {
+		struct clui_shell_job * job = &clui_the_jobs.jobs[j];
+
+		if (job->state == CLUI_SHELL_JOB_FREE) {
+			if (!++clui_the_jobs.last_id)
+				clui_the_jobs.last_id++;
+
+			job->id = clui_the_jobs.last_id;
+
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+int __clui_nonull(1, 2)
+clui_shell_spawn_job(const struct clui_shell_expr * expr,
+                     clui_shell_job_fn *            run,
+                     clui_shell_release_job_fn *    release,
+                     void *                         data)
+{
+	clui_assert(expr);
+	clui_assert(run);
+
+	struct clui_shell_job * job;
+	char *                  ln;
+	int                     ret;
+
+	ln = clui_shell_join_expr(expr);
+	if (!ln)
+		return -errno;
+
+	pthread_mutex_lock(&clui_the_jobs.lock);
+
+	ret = clui_shell_start_job_workers();
+	if (ret)
+		goto unlock;
+
+	job = clui_shell_alloc_job();
+	if (!job) {
+		ret = -EAGAIN;
+		goto unlock;
+	}
+
+	job->state = CLUI_SHELL_JOB_PENDING;
+	job->cancel = 0;
+	job->ret = 0;
+	job->run = run;
+	job->release = release;
+	job->data = data;
+	job->ln = ln;
+	job->next = NULL;
+
+	if (clui_the_jobs.tail)
+		clui_the_jobs.tail->next = job;
+	else
+		clui_the_jobs.head = job;
+	clui_the_jobs.tail = job;
+
+	pthread_cond_signal(&clui_the_jobs.todo);
+
+	pthread_mutex_unlock(&clui_the_jobs.lock);
+
+	return job->id;
+
+unlock:
+	pthread_mutex_unlock(&clui_the_jobs.lock);
+	clui_mem_free(CLUI_MEM_EXPR_SYS, ln);
+
+	return ret;
+}
+
+static struct clui_shell_job *
+clui_shell_find_job(const char * arg)
+{
+	unsigned long id;
+	char *        end;
+	unsigned int  j;
+
+	/* Accept both "<id>" and "%<id>" job specifications. */
+	if (*arg == '%')
+		arg++;
+
+	id = strtoul(arg, &end, 10);
+	if (!*arg || *end || !id)
+		return NULL;
+
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++) {
+		struct clui_shell_job * job = &clui_the_jobs.jobs[j];
+
+		if ((job->state != CLUI_SHELL_JOB_FREE) && (job->id == id))
+			return job;
+	}
+
+	return NULL;
+}
+
+/*
+ * Job lines are shorter than LINE_MAX, leave room for the identifier and
+ * status in front.
+ */
+#define CLUI_SHELL_JOB_NOTICE_SIZE (LINE_MAX + 64)
+
+/*
+ * Format job status notice with jobs lock held so that it may be printed once
+ * the lock is released.
+ */
+static void
+clui_shell_format_job(const struct clui_shell_job * job,
+                      char                          notice[])
+{
+	clui_assert(job);
+	clui_assert(job->state != CLUI_SHELL_JOB_FREE);
+	clui_assert(notice);
+
+	switch (job->state) {
+	case CLUI_SHELL_JOB_PENDING:
+		snprintf(notice,
+		         CLUI_SHELL_JOB_NOTICE_SIZE,
+		         "[%u] Pending        %s\n",
+		         job->id,
+		         job->ln);
+		break;
+
+	case CLUI_SHELL_JOB_RUNNING:
+		snprintf(notice,
+		         CLUI_SHELL_JOB_NOTICE_SIZE,
+		         "[%u] %-14s %s\n",
+		         job->id,
+		         job->cancel ? "Killing" : "Running",
+		         job->ln);
+		break;
+
+	case CLUI_SHELL_JOB_DONE:
+		if (!job->ret)
+			snprintf(notice,
+			         CLUI_SHELL_JOB_NOTICE_SIZE,
+			         "[%u] Done           %s\n",
+			         job->id,
+			         job->ln);
+		else if (job->ret < 0)
+			snprintf(notice,
+			         CLUI_SHELL_JOB_NOTICE_SIZE,
+			         "[%u] Failed (%s) %s\n",
+			         job->id,
+			         strerror(-job->ret),
+			         job->ln);
+		else
+			snprintf(notice,
+			         CLUI_SHELL_JOB_NOTICE_SIZE,
+			         "[%u] Exit %-9d %s\n",
+			         job->id,
+			         job->ret,
+			         job->ln);
+		break;
+
+	default:
+		clui_assert(0);
+	}
+}
+
+/* Release completed job, leaving its status notice into notice. */
+static void
+clui_shell_reap_job(struct clui_shell_job * job, char notice[])
+{
+	clui_assert(job);
+	clui_assert(job->state == CLUI_SHELL_JOB_DONE);
+
+	clui_shell_format_job(job, notice);
+
+	clui_mem_free(CLUI_MEM_EXPR_SYS, job->ln);
+	job->ln = NULL;
+	job->state = CLUI_SHELL_JOB_FREE;
+}
+
+/*
+ * Release all completed jobs and print their notices. Jobs lock is dropped
+ * while printing so that workers are never held up by a slow terminal.
+ */
+static void
+clui_shell_reap_all_jobs(void)
+{
+	unsigned int j;
+
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++) {
+		struct clui_shell_job * job = &clui_the_jobs.jobs[j];
+		char                    notice[CLUI_SHELL_JOB_NOTICE_SIZE];
+		bool                    done;
+
+		pthread_mutex_lock(&clui_the_jobs.lock);
+		done = (job->state == CLUI_SHELL_JOB_DONE);
+		if (done)
+			clui_shell_reap_job(job, notice);
+		pthread_mutex_unlock(&clui_the_jobs.lock);
+
+		if (done)
+			fputs(notice, stdout);
+	}
+}
+
+void
+clui_shell_report_jobs(void)
+{
+	clui_shell_reap_all_jobs();
+
+	fflush(stdout);
+}
+
+int __clui_nonull(1)
+clui_shell_jobs_builtin(const struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+
+	unsigned int j;
+
+	if (expr->nr > 1) {
+		fprintf(stderr, "jobs: unexpected argument '%s'.\n",
+		        expr->words[1]);
+		return -EINVAL;
+	}
+
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++) {
+		struct clui_shell_job * job = &clui_the_jobs.jobs[j];
+		char                    notice[CLUI_SHELL_JOB_NOTICE_SIZE];
+
+		pthread_mutex_lock(&clui_the_jobs.lock);
+		if (job->state == CLUI_SHELL_JOB_DONE)
+			clui_shell_reap_job(job, notice);
+		else if (job->state != CLUI_SHELL_JOB_FREE)
+			clui_shell_format_job(job, notice);
+		else
+			notice[0] = '\0';
+		pthread_mutex_unlock(&clui_the_jobs.lock);
+
+		fputs(notice, stdout);
+	}
+
+	fflush(stdout);
+
+	return 0;
+}
+
+/* Period at which waiting for jobs checks for user interruption. */
+#define CLUI_SHELL_WAIT_TICK_MSEC (100L)
+
+/* Set by the SIGINT handler installed while waiting for jobs. */
+static volatile sig_atomic_t clui_shell_wait_intr;
+
+static void
+clui_shell_intr_wait(int signo __unused)
+{
+	clui_shell_wait_intr = 1;
+}
+
+/*
+ * Wait for a job to complete, or for the user to interrupt waiting using
+ * ^C. Since pthread_cond_wait() is not interrupted by signals, the
+ * interruption flag is polled periodically.
+ * Must be called with jobs lock held.
+ */
+static int
+clui_shell_wait_done(void)
+{
+	struct timespec tmout;
+
+	if (clui_shell_wait_intr)
+		return -EINTR;
+
+	clock_gettime(CLOCK_REALTIME, &tmout);
+	tmout.tv_nsec += CLUI_SHELL_WAIT_TICK_MSEC * 1000000L;
+	if (tmout.tv_nsec >= 1000000000L) {
+		tmout.tv_sec++;
+		tmout.tv_nsec -= 1000000000L;
+	}
+
+	pthread_cond_timedwait(&clui_the_jobs.done,
+	                       &clui_the_jobs.lock,
+	                       &tmout);
+
+	return clui_shell_wait_intr ? -EINTR : 0;
+}
+
+static bool
+clui_shell_jobs_busy(void)
+{
+	unsigned int j;
+
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++) {
+		enum clui_shell_job_state state = clui_the_jobs.jobs[j].state;
+
+		if ((state == CLUI_SHELL_JOB_PENDING) ||
+		    (state == CLUI_SHELL_JOB_RUNNING))
+			return true;
+	}
+
+	return false;
+}
+
+int __clui_nonull(1)
+clui_shell_wait_builtin(const struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+
+	struct sigaction act = { .sa_handler = clui_shell_intr_wait };
+	struct sigaction old;
+	unsigned int     w;
+	int              ret = 0;
+
+	/* Let user stop waiting using ^C. */
+	clui_shell_wait_intr = 0;
+	sigemptyset(&act.sa_mask);
+	sigaction(SIGINT, &act, &old);
+
+	pthread_mutex_lock(&clui_the_jobs.lock);
+
+	if (expr->nr == 1) {
+		/* Wait for all jobs to complete. */
+		while (clui_shell_jobs_busy()) {
+			ret = clui_shell_wait_done();
+			if (ret)
+				goto unlock;
+		}
+
+		pthread_mutex_unlock(&clui_the_jobs.lock);
+		clui_shell_reap_all_jobs();
+		goto restore;
+	}
+
+	for (w = 1; w < expr->nr; w++) {
+		struct clui_shell_job * job;
+		char                    notice[CLUI_SHELL_JOB_NOTICE_SIZE];
+
+		job = clui_shell_find_job(expr->words[w]);
+		if (!job) {
+			pthread_mutex_unlock(&clui_the_jobs.lock);
+			fprintf(stderr, "wait: unknown job '%s'.\n",
+			        expr->words[w]);
+			pthread_mutex_lock(&clui_the_jobs.lock);
+			ret = -ENOENT;
+			continue;
+		}
+
+		while (job->state != CLUI_SHELL_JOB_DONE) {
+			ret = clui_shell_wait_done();
+			if (ret)
+				goto unlock;
+		}
+
+		ret = job->ret;
+		clui_shell_reap_job(job, notice);
+
+		pthread_mutex_unlock(&clui_the_jobs.lock);
+		fputs(notice, stdout);
+		pthread_mutex_lock(&clui_the_jobs.lock);
+	}
+
+unlock:
+	pthread_mutex_unlock(&clui_the_jobs.lock);
+
+restore:
+	sigaction(SIGINT, &old, NULL);
+
+	if (ret == -EINTR)
+		fprintf(stderr, "\nwait: interrupted.\n");
+
+	fflush(stdout);
+
+	return ret;
+}
+
+static void
+clui_shell_unqueue_job(struct clui_shell_job * job)
+{
+	clui_assert(job);
+	clui_assert(job->state == CLUI_SHELL_JOB_PENDING);
+
+	struct clui_shell_job ** ref = &clui_the_jobs.head;
+	struct clui_shell_job *  prev = NULL;
+
+	while (*ref != job) {
+		clui_assert(*ref);
+
+		prev = *ref;
+		ref = &(*ref)->next;
+	}
+
+	*ref = job->next;
+	if (clui_the_jobs.tail == job)
+		clui_the_jobs.tail = prev;
+
+	job->next = NULL;
+}
+
+int __clui_nonull(1)
+clui_shell_kill_builtin(const struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+
+	unsigned int w;
+	int          ret = 0;
+
+	if (expr->nr < 2) {
+		fprintf(stderr, "kill: missing job.\n");
+		return -EINVAL;
+	}
+
+	pthread_mutex_lock(&clui_the_jobs.lock);
+
+	for (w = 1; w < expr->nr; w++) {
+		struct clui_shell_job * job;
+
+		job = clui_shell_find_job(expr->words[w]);
+		if (!job) {
+			fprintf(stderr, "kill: unknown job '%s'.\n",
+			        expr->words[w]);
+			ret = -ENOENT;
+			continue;
+		}
+
+		switch (job->state) {
+		case CLUI_SHELL_JOB_PENDING:
+			/*
+			 * Job has not started yet: just drop it. Mark it as
+			 * being killed while releasing it unlocked, as workers
+			 * do, since the release callback may use the job API.
+			 */
+			clui_shell_unqueue_job(job);
+			job->state = CLUI_SHELL_JOB_RUNNING;
+			job->cancel = 1;
+
+			pthread_mutex_unlock(&clui_the_jobs.lock);
+			clui_shell_release_job(job);
+			pthread_mutex_lock(&clui_the_jobs.lock);
+
+			clui_shell_complete_job(job, -ECANCELED);
+			break;
+
+		case CLUI_SHELL_JOB_RUNNING:
+			/*
+			 * Request running job to stop. It is up to the job
+			 * function to poll clui_shell_job_cancelled() and
+			 * return as soon as possible.
+			 */
+			job->cancel = 1;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&clui_the_jobs.lock);
+
+	return ret;
+}
+
+void
+clui_shell_fini_jobs(void)
+{
+	struct clui_shell_job * pending;
+	unsigned int            j;
+
+	pthread_mutex_lock(&clui_the_jobs.lock);
+
+	/* Request running jobs to stop and workers to exit. */
+	clui_the_jobs.stop = true;
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++)
+		clui_the_jobs.jobs[j].cancel = 1;
+
+	pending = clui_the_jobs.head;
+	clui_the_jobs.head = NULL;
+	clui_the_jobs.tail = NULL;
+
+	pthread_cond_broadcast(&clui_the_jobs.todo);
+
+	pthread_mutex_unlock(&clui_the_jobs.lock);
+
+	/* Drop jobs that have not started yet. */
+	while (pending) {
+		struct clui_shell_job * job = pending;
+
+		pending = job->next;
+		clui_shell_release_job(job);
+		job->state = CLUI_SHELL_JOB_DONE;
+	}
+
+	for (j = 0; j < clui_the_jobs.workers_nr; j++)
+		pthread_join(clui_the_jobs.workers[j], NULL);
+
+	for (j = 0; j < CLUI_SHELL_JOB_MAX; j++) {
+		clui_mem_free(CLUI_MEM_EXPR_SYS, clui_the_jobs.jobs[j].ln);
+		clui_the_jobs.jobs[j].ln = NULL;
+		clui_the_jobs.jobs[j].state = CLUI_SHELL_JOB_FREE;
+	}
+
+	clui_the_jobs.workers_nr = 0;
+	clui_the_jobs.stop = false;
+}
@@ -0,0 +1,203 @@
+#include "mem_priv.h"
+
+/*
+ * Counters are updated from any thread since history is loaded in the
+ * background and jobs run onto worker threads.
+ */
+struct clui_mem_sys_stats {
+	size_t              live;
+	size_t              peak;
+	unsigned long       allocs;
+	unsigned long       frees;
+	clui_mem_probe_fn * probe;
+};
+
+static struct clui_mem_sys_stats clui_mem_the_stats[CLUI_MEM_SYS_NR];
+static clui_mem_hook_fn *        clui_mem_the_hook;
+static __thread unsigned long    clui_mem_thread_cnt;
+
+#define clui_assert_mem_sys(_sys) \
+	clui_assert((unsigned int)(_sys) < CLUI_MEM_SYS_NR)
+
+static void
+clui_mem_charge(enum clui_mem_sys sys, size_t size)
+{
+	struct clui_mem_sys_stats * stats = &clui_mem_the_stats[sys];
+	clui_mem_hook_fn *          hook;
+	size_t                      live;
+	size_t                      peak;
+
+	clui_mem_thread_cnt++;
+	__atomic_add_fetch(&stats->allocs, 1, __ATOMIC_RELAXED);
+
+	live = __atomic_add_fetch(&stats->live, size, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+	while ((live > peak) &&
+	       !__atomic_compare_exchange_n(&stats->peak,
+	                                    &peak,
+	                                    live,
+	                                    true,
+	                                    __ATOMIC_RELAXED,
+	                                    __ATOMIC_RELAXED))
+		;
+
+	hook = __atomic_load_n(&clui_mem_the_hook, __ATOMIC_RELAXED);
+	if (hook)
+		hook(sys, size);
+}
+
+static void
+clui_mem_drop(enum clui_mem_sys sys, size_t size)
+{
+	__atomic_sub_fetch(&clui_mem_the_stats[sys].live,
+	                   size,
+	                   __ATOMIC_RELAXED);
+}
+
+static void
+clui_mem_discharge(enum clui_mem_sys sys, size_t size)
+{
+	clui_mem_drop(sys, size);
+	__atomic_add_fetch(&clui_mem_the_stats[sys].frees, 1, __ATOMIC_RELAXED);
+}
+
+void *
+clui_mem_alloc(enum clui_mem_sys sys, size_t size)
+{
+	clui_assert_mem_sys(sys);
+
+	void * ptr;
+
+	ptr = malloc(size);
+	if (ptr)
+		clui_mem_charge(sys, clui_mem_size(ptr));
+
+	return ptr;
+}
+
+void *
+clui_mem_realloc(enum clui_mem_sys sys, void * ptr, size_t size)
+{
+	clui_assert_mem_sys(sys);
+
+	size_t old = ptr ? clui_mem_size(ptr) : 0;
+	void * tmp;
+
+	tmp = realloc(ptr, size);
+	if (!tmp)
+		return NULL;
+
+	if (ptr)
+		clui_mem_discharge(sys, old);
+	clui_mem_charge(sys, clui_mem_size(tmp));
+
+	return tmp;
+}
+
+char * __clui_nonull(2)
+clui_mem_strndup(enum clui_mem_sys sys, const char * str, size_t len)
+{
+	clui_assert_mem_sys(sys);
+	clui_assert(str);
+
+	char * dup;
+
+	dup = strndup(str, len);
+	if (dup)
+		clui_mem_charge(sys, clui_mem_size(dup));
+
+	return dup;
+}
+
+void
+clui_mem_free(enum clui_mem_sys sys, void * ptr)
+{
+	clui_assert_mem_sys(sys);
+
+	if (!ptr)
+		return;
+
+	clui_mem_discharge(sys, clui_mem_size(ptr));
+	free(ptr);
+}
+
+void
+clui_mem_disown(enum clui_mem_sys sys, void * ptr)
+{
+	clui_assert_mem_sys(sys);
+
+	if (ptr)
+		clui_mem_drop(sys, clui_mem_size(ptr));
+}
+
+void
+clui_mem_account(enum clui_mem_sys sys, size_t size)
+{
+	clui_assert_mem_sys(sys);
+
+	clui_mem_charge(sys, size);
+}
+
+void
+clui_mem_unaccount(enum clui_mem_sys sys, size_t size)
+{
+	clui_assert_mem_sys(sys);
+
+	clui_mem_discharge(sys, size);
+}
+
+void
+clui_mem_set_probe(enum clui_mem_sys sys, clui_mem_probe_fn * probe)
+{
+	clui_assert_mem_sys(sys);
+
+	__atomic_store_n(&clui_mem_the_stats[sys].probe,
+	                 probe,
+	                 __ATOMIC_RELAXED);
+}
+
+void __clui_nonull(2)
+clui_mem_get_stats(enum clui_mem_sys sys, struct clui_mem_stats * stats)
+{
+	clui_assert_mem_sys(sys);
+	clui_assert(stats);
+
+	struct clui_mem_sys_stats * curr = &clui_mem_the_stats[sys];
+	clui_mem_probe_fn *         probe;
+
+	stats->live = __atomic_load_n(&curr->live, __ATOMIC_RELAXED);
+	stats->peak = __atomic_load_n(&curr->peak, __ATOMIC_RELAXED);
+	stats->allocs = __atomic_load_n(&curr->allocs, __ATOMIC_RELAXED);
+	stats->frees = __atomic_load_n(&curr->frees, __ATOMIC_RELAXED);
+
+	probe = __atomic_load_n(&curr->probe, __ATOMIC_RELAXED);
+	if (probe)
+		stats->live += probe();
+
+	if (stats->live > stats->peak)
+		stats->peak = stats->live;
+}
+
+void
+clui_mem_reset_peak(enum clui_mem_sys sys)
+{
+	clui_assert_mem_sys(sys);
+
+	struct clui_mem_sys_stats * stats = &clui_mem_the_stats[sys];
+
+	__atomic_store_n(&stats->peak,
+	                 __atomic_load_n(&stats->live, __ATOMIC_RELAXED),
+	                 __ATOMIC_RELAXED);
+}
+
+unsigned long
+clui_mem_thread_allocs(void)
+{
+	return clui_mem_thread_cnt;
+}
+
+void
+clui_mem_set_hook(clui_mem_hook_fn * hook)
+{
+	__atomic_store_n(&clui_mem_the_hook, hook, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,103 @@
+#ifndef _CLUI_MEM_PRIV_H
+#define _CLUI_MEM_PRIV_H
+
+#include <clui/mem.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CONFIG_CLUI_MEM_STATS)
+
+#include <malloc.h>
+
+extern void *
+clui_mem_alloc(enum clui_mem_sys sys, size_t size);
+
+extern void *
+clui_mem_realloc(enum clui_mem_sys sys, void * ptr, size_t size);
+
+extern char *
+clui_mem_strndup(enum clui_mem_sys sys, const char * str, size_t len)
+	__clui_nonull(2);
+
+extern void
+clui_mem_free(enum clui_mem_sys sys, void * ptr);
+
+/* Stop accounting memory which ownership is handed over to readline. */
+extern void
+clui_mem_disown(enum clui_mem_sys sys, void * ptr);
+
+/* Account memory allocated by third parties on our behalf. */
+extern void
+clui_mem_account(enum clui_mem_sys sys, size_t size);
+
+extern void
+clui_mem_unaccount(enum clui_mem_sys sys, size_t size);
+
+/* Usage of memory owned by third parties, computed upon query. */
+typedef size_t (clui_mem_probe_fn)(void);
+
+extern void
+clui_mem_set_probe(enum clui_mem_sys sys, clui_mem_probe_fn * probe);
+
+static inline size_t
+clui_mem_size(const void * ptr)
+{
+	return malloc_usable_size((void *)ptr);
+}
+
+#else  /* !defined(CONFIG_CLUI_MEM_STATS) */
+
+static inline void *
+clui_mem_alloc(enum clui_mem_sys sys __unused, size_t size)
+{
+	return malloc(size);
+}
+
+static inline void *
+clui_mem_realloc(enum clui_mem_sys sys __unused, void * ptr, size_t size)
+{
+	return realloc(ptr, size);
+}
+
+static inline char *
+clui_mem_strndup(enum clui_mem_sys sys __unused, const char * str, size_t len)
+{
+	return strndup(str, len);
+}
+
+static inline void
+clui_mem_free(enum clui_mem_sys sys __unused, void * ptr)
+{
+	free(ptr);
+}
+
+static inline void
+clui_mem_disown(enum clui_mem_sys sys __unused, void * ptr __unused)
+{
+}
+
+static inline void
+clui_mem_account(enum clui_mem_sys sys __unused, size_t size __unused)
+{
+}
+
+static inline void
+clui_mem_unaccount(enum clui_mem_sys sys __unused, size_t size __unused)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_MEM_STATS) */
+
+static inline void *
+clui_mem_zalloc(enum clui_mem_sys sys, size_t size)
+{
+	void * ptr;
+
+	ptr = clui_mem_alloc(sys, size);
+	if (ptr)
+		memset(ptr, 0, size);
+
+	return ptr;
+}
+
+#endif /* _CLUI_MEM_PRIV_H */
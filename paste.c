@@ -0,0 +1,290 @@
+#include "shell_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * Bracketed paste mode: terminals surround pasted text with these sequences,
+ * see readline enable-bracketed-paste variable.
+ */
+#define CLUI_SHELL_PASTE_BEGIN "\033[200~"
+#define CLUI_SHELL_PASTE_END   "\033[201~"
+
+struct clui_shell_paste_expr {
+	int                    err;
+	struct clui_shell_expr expr;
+};
+
+/*
+ * Expressions carved out of pasted lines past the first one, which readline
+ * returns as usual. These are handed out one by one by clui_shell_pop_paste()
+ * without going through readline() again.
+ */
+struct clui_shell_paste {
+	struct clui_shell_paste_expr * exprs;
+	unsigned int                   nr;
+	unsigned int                   size;
+	unsigned int                   next;
+	bool                           committed;
+	char *                         rest;
+};
+
+static struct clui_shell_paste clui_the_paste = { .committed = true };
+
+static void
+clui_shell_push_paste(const char * line, size_t len)
+{
+	struct clui_shell_paste *      paste = &clui_the_paste;
+	struct clui_shell_paste_expr * pexpr;
+	char *                         ln;
+
+	if (paste->nr == paste->size) {
+		unsigned int                   size;
+		struct clui_shell_paste_expr * tmp;
+
+		size = paste->size ? (2 * paste->size) : 64;
+		tmp = realloc(paste->exprs, size * sizeof(tmp[0]));
+		if (!tmp)
+			return;
+
+		paste->exprs = tmp;
+		paste->size = size;
+	}
+
+	pexpr = &paste->exprs[paste->nr];
+
+	ln = strndup(line, len);
+	if (ln) {
+		pexpr->err = clui_shell_parse_expr(&pexpr->expr, ln);
+		if (pexpr->err) {
+			free(ln);
+			if (pexpr->err == -ENODATA)
+				/* Blank line. */
+				return;
+		}
+	}
+	else
+		pexpr->err = -ENOMEM;
+
+	paste->nr++;
+}
+
+/* Break pasted text into lines and parse them in a single pass. */
+static void
+clui_shell_ingest_paste(const char * text)
+{
+	clui_assert(!clui_the_paste.nr);
+	clui_assert(!clui_the_paste.rest);
+
+	while (true) {
+		size_t len = strcspn(text, "\r\n");
+
+		if (!text[len])
+			break;
+
+		if (len)
+			clui_shell_push_paste(text, len);
+
+		if ((text[len] == '\r') && (text[len + 1] == '\n'))
+			len++;
+		text += len + 1;
+	}
+
+	if (*text)
+		/* Last line has no line break: leave it for the user to edit. */
+		clui_the_paste.rest = strdup(text);
+
+	clui_the_paste.committed = !clui_the_paste.nr;
+}
+
+static char *
+clui_shell_read_paste(void)
+{
+	const size_t end_len = sizeof(CLUI_SHELL_PASTE_END) - 1;
+	size_t       size = 4096;
+	size_t       len = 0;
+	char *       text;
+
+	text = malloc(size);
+	if (!text)
+		return NULL;
+
+	clui_shell_bulk_input(true);
+
+	while (true) {
+		int c;
+
+		c = rl_read_key();
+		if ((c < 0) || rl_done)
+			/* End of input or shutdown request. */
+			goto free;
+
+		if ((len + 1) == size) {
+			char * tmp;
+
+			tmp = realloc(text, 2 * size);
+			if (!tmp)
+				goto free;
+
+			text = tmp;
+			size *= 2;
+		}
+
+		text[len++] = (char)c;
+		if ((len >= end_len) &&
+		    !memcmp(&text[len - end_len], CLUI_SHELL_PASTE_END, end_len))
+			break;
+	}
+
+	clui_shell_bulk_input(false);
+
+	text[len - end_len] = '\0';
+
+	return text;
+
+free:
+	clui_shell_bulk_input(false);
+	free(text);
+
+	return NULL;
+}
+
+static int
+clui_shell_paste_key(int count __unused, int key)
+{
+	char * text;
+	char * brk;
+
+	text = clui_shell_read_paste();
+	if (!text) {
+		rl_ding();
+		return 0;
+	}
+
+	brk = &text[strcspn(text, "\r\n")];
+	if (!*brk) {
+		/* Single line: insert it at once. */
+		rl_insert_text(text);
+		free(text);
+
+		return 0;
+	}
+
+	/*
+	 * Complete current line with text preceding the first line break and
+	 * queue the remaining lines.
+	 */
+	clui_shell_ingest_paste(&brk[((brk[0] == '\r') && (brk[1] == '\n')) ?
+	                            2 : 1]);
+	*brk = '\0';
+	rl_insert_text(text);
+
+	free(text);
+
+	/* Accept current line as if the return key was hit. */
+	return rl_newline(1, key);
+}
+
+static int
+clui_shell_insert_paste(void)
+{
+	rl_startup_hook = NULL;
+
+	if (clui_the_paste.rest) {
+		rl_insert_text(clui_the_paste.rest);
+
+		free(clui_the_paste.rest);
+		clui_the_paste.rest = NULL;
+	}
+
+	return 0;
+}
+
+static void
+clui_shell_reset_paste(void)
+{
+	free(clui_the_paste.exprs);
+	clui_the_paste.exprs = NULL;
+	clui_the_paste.nr = 0;
+	clui_the_paste.size = 0;
+	clui_the_paste.next = 0;
+	clui_the_paste.committed = true;
+}
+
+void
+clui_shell_commit_paste(void)
+{
+	struct clui_shell_paste * paste = &clui_the_paste;
+	unsigned int              e;
+
+	if (paste->committed)
+		return;
+
+	for (e = paste->next; e < paste->nr; e++) {
+		if (!paste->exprs[e].err)
+			clui_shell_commit_expr(&paste->exprs[e].expr);
+	}
+
+	paste->committed = true;
+}
+
+int __clui_nonull(1)
+clui_shell_pop_paste(struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+
+	struct clui_shell_paste * paste = &clui_the_paste;
+
+	clui_shell_commit_paste();
+
+	if (paste->next < paste->nr) {
+		const struct clui_shell_paste_expr * pexpr;
+
+		/* Expression ownership is transferred to the caller. */
+		pexpr = &paste->exprs[paste->next++];
+		if (pexpr->err)
+			return pexpr->err;
+
+		*expr = pexpr->expr;
+
+		return 0;
+	}
+
+	if (paste->nr)
+		clui_shell_reset_paste();
+
+	if (paste->rest)
+		/* Have the last pasted line inserted into next input line. */
+		rl_startup_hook = clui_shell_insert_paste;
+
+	return -ENOENT;
+}
+
+void
+clui_shell_drop_paste(void)
+{
+	struct clui_shell_paste * paste = &clui_the_paste;
+
+	for (; paste->next < paste->nr; paste->next++) {
+		if (!paste->exprs[paste->next].err)
+			clui_shell_free_expr(&paste->exprs[paste->next].expr);
+	}
+
+	clui_shell_reset_paste();
+
+	free(paste->rest);
+	paste->rest = NULL;
+	if (rl_startup_hook == clui_shell_insert_paste)
+		rl_startup_hook = NULL;
+}
+
+void
+clui_shell_init_paste(void)
+{
+	rl_bind_keyseq_in_map(CLUI_SHELL_PASTE_BEGIN,
+	                      clui_shell_paste_key,
+	                      emacs_standard_keymap);
+	rl_bind_keyseq_in_map(CLUI_SHELL_PASTE_BEGIN,
+	                      clui_shell_paste_key,
+	                      vi_insertion_keymap);
+}
@@ -0,0 +1,410 @@
+#include "shell_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Number of directory listings kept around. */
+#define CLUI_SHELL_PATH_CACHE_NR (4U)
+
+/* Size of buffer getdents64(2) fills with directory entries. */
+#define CLUI_SHELL_PATH_DENTS_SIZE (32768U)
+
+/* Directory entry: name is an offset into its listing names buffer. */
+struct clui_shell_path_ent {
+	unsigned int   name;
+	unsigned short len;
+	unsigned char  type;
+};
+
+/*
+ * Listing of a directory, sorted by entry names so that entries matching a
+ * prefix are located using a binary search.
+ * It remains valid as long as the directory modification time is left
+ * untouched. A directory modified within the second it was listed in is
+ * marked as racy and listed again upon next lookup since further updates
+ * within the same timestamp granularity would go unnoticed.
+ */
+struct clui_shell_path_dir {
+	dev_t                        dev;
+	ino_t                        ino;
+	struct timespec              mtime;
+	bool                         racy;
+	unsigned long                stamp;
+	struct clui_shell_path_ent * ents;
+	unsigned int                 nr;
+	char *                       names;
+};
+
+struct clui_shell_path_cache {
+	unsigned long              stamp;
+	struct clui_shell_path_dir dirs[CLUI_SHELL_PATH_CACHE_NR];
+};
+
+static struct clui_shell_path_cache clui_shell_the_path_cache;
+
+static void
+clui_shell_clear_path_dir(struct clui_shell_path_dir * dir)
+{
+	free(dir->ents);
+	free(dir->names);
+
+	dir->stamp = 0;
+	dir->ents = NULL;
+	dir->nr = 0;
+	dir->names = NULL;
+}
+
+static int
+clui_shell_cmp_path_ents(const void * first, const void * second, void * data)
+{
+	const char * names = data;
+
+	return strcmp(&names[((const struct clui_shell_path_ent *)first)->name],
+	              &names[((const struct clui_shell_path_ent *)second)->name]);
+}
+
+/*
+ * Names holding blanks are skipped since shell expressions are split on
+ * blanks without any quoting support.
+ */
+static bool
+clui_shell_path_name_ok(const char * name, size_t len)
+{
+	if ((name[0] == '.') &&
+	    ((len == 1) || ((len == 2) && (name[1] == '.'))))
+		return false;
+
+	if (len >= NAME_MAX + 1)
+		return false;
+
+	return !strpbrk(name, " \t\n\v\f\r");
+}
+
+static int
+clui_shell_list_path_dir(struct clui_shell_path_dir * dir, int fd)
+{
+	char                         dents[CLUI_SHELL_PATH_DENTS_SIZE];
+	struct clui_shell_path_ent * ents = NULL;
+	unsigned int                 nr = 0;
+	unsigned int                 size = 0;
+	char *                       names = NULL;
+	size_t                       used = 0;
+	size_t                       room = 0;
+	ssize_t                      ret;
+
+	while ((ret = getdents64(fd, dents, sizeof(dents))) > 0) {
+		ssize_t off = 0;
+
+		while (off < ret) {
+			const struct dirent64 * dent;
+			size_t                  len;
+
+			dent = (const struct dirent64 *)&dents[off];
+			off += dent->d_reclen;
+
+			len = strlen(dent->d_name);
+			if (!clui_shell_path_name_ok(dent->d_name, len))
+				continue;
+
+			if (nr == size) {
+				struct clui_shell_path_ent * tmp;
+
+				size = size ? (2 * size) : 256;
+				tmp = realloc(ents, size * sizeof(tmp[0]));
+				if (!tmp)
+					goto nomem;
+				ents = tmp;
+			}
+
+			if ((used + len + 1) > room) {
+				char * tmp;
+
+				room = room ? (2 * room) : 4096;
+				tmp = realloc(names, room);
+				if (!tmp)
+					goto nomem;
+				names = tmp;
+			}
+
+			if ((used + len) > UINT_MAX)
+				goto nomem;
+
+			memcpy(&names[used], dent->d_name, len + 1);
+
+			ents[nr].name = (unsigned int)used;
+			ents[nr].len = (unsigned short)len;
+			ents[nr].type = dent->d_type;
+			nr++;
+
+			used += len + 1;
+		}
+	}
+
+	if (ret < 0) {
+		ret = -errno;
+		goto free;
+	}
+
+	qsort_r(ents, nr, sizeof(ents[0]), clui_shell_cmp_path_ents, names);
+
+	dir->ents = ents;
+	dir->nr = nr;
+	dir->names = names;
+
+	return 0;
+
+nomem:
+	ret = -ENOMEM;
+free:
+	free(names);
+	free(ents);
+
+	return (int)ret;
+}
+
+/*
+ * Return the listing of the directory fd refers to, reusing cached content
+ * unless the directory was modified since.
+ */
+static const struct clui_shell_path_dir *
+clui_shell_get_path_dir(int fd)
+{
+	struct clui_shell_path_cache * cache = &clui_shell_the_path_cache;
+	struct clui_shell_path_dir *   dir = NULL;
+	struct stat                    st;
+	struct timespec                now;
+	unsigned int                   d;
+	int                            err;
+
+	if (fstat(fd, &st))
+		return NULL;
+
+	for (d = 0; d < array_nr(cache->dirs); d++) {
+		struct clui_shell_path_dir * curr = &cache->dirs[d];
+
+		if (curr->stamp &&
+		    (curr->dev == st.st_dev) &&
+		    (curr->ino == st.st_ino)) {
+			dir = curr;
+			break;
+		}
+
+		/* Pick least recently used entry for eviction. */
+		if (!dir || (curr->stamp < dir->stamp))
+			dir = curr;
+	}
+
+	if ((dir->stamp) &&
+	    (dir->dev == st.st_dev) &&
+	    (dir->ino == st.st_ino) &&
+	    !dir->racy &&
+	    (dir->mtime.tv_sec == st.st_mtim.tv_sec) &&
+	    (dir->mtime.tv_nsec == st.st_mtim.tv_nsec))
+		goto hit;
+
+	clui_shell_clear_path_dir(dir);
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	err = clui_shell_list_path_dir(dir, fd);
+	if (err) {
+		errno = -err;
+		return NULL;
+	}
+
+	dir->dev = st.st_dev;
+	dir->ino = st.st_ino;
+	dir->mtime = st.st_mtim;
+	dir->racy = (st.st_mtim.tv_sec >= now.tv_sec);
+
+hit:
+	dir->stamp = ++cache->stamp;
+
+	return dir;
+}
+
+/* Index of the first entry greater than or equal to prefix. */
+static unsigned int
+clui_shell_find_path_ent(const struct clui_shell_path_dir * dir,
+                         const char *                       prefix,
+                         size_t                             len)
+{
+	unsigned int lo = 0;
+	unsigned int hi = dir->nr;
+
+	while (lo < hi) {
+		unsigned int mid = lo + ((hi - lo) / 2);
+
+		if (strncmp(&dir->names[dir->ents[mid].name], prefix, len) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Resolve types of symbolic links and entries the filesystem did not tell. */
+static unsigned char
+clui_shell_path_ent_type(int fd, const char * name, unsigned char type)
+{
+	struct stat st;
+
+	if ((type != DT_LNK) && (type != DT_UNKNOWN))
+		return type;
+
+	if (fstatat(fd, name, &st, 0))
+		/* Dangling link. */
+		return DT_UNKNOWN;
+
+	return IFTODT(st.st_mode);
+}
+
+static bool
+clui_shell_path_ext_ok(const char * name,
+                       size_t       len,
+                       const char * const exts[])
+{
+	if (!exts)
+		return true;
+
+	while (*exts) {
+		size_t elen = strlen(*exts);
+
+		if ((elen <= len) && !strcmp(&name[len - elen], *exts))
+			return true;
+		exts++;
+	}
+
+	return false;
+}
+
+static bool
+clui_shell_path_type_ok(const struct clui_shell_path_filter * filter,
+                        const char *                          name,
+                        size_t                                len,
+                        unsigned char                         type)
+{
+	if (type == DT_DIR)
+		return true;
+
+	if (!filter)
+		return true;
+
+	if (type == DT_REG)
+		return (filter->types & CLUI_SHELL_PATH_REG) &&
+		       clui_shell_path_ext_ok(name, len, filter->exts);
+
+	return !!(filter->types & CLUI_SHELL_PATH_OTHER);
+}
+
+int __clui_nonull(1)
+clui_shell_generate_paths(struct clui_shell_gen * gen, void * data)
+{
+	clui_assert(gen);
+	clui_assert(gen->word);
+
+	const struct clui_shell_path_filter * filter = data;
+	const char *                          base;
+	size_t                                dlen;
+	size_t                                blen;
+	char                                  cand[LINE_MAX];
+	int                                   fd;
+	const struct clui_shell_path_dir *    dir;
+	unsigned int                          e;
+	int                                   ret = 0;
+
+	base = strrchr(gen->word, '/');
+	base = base ? (base + 1) : gen->word;
+	dlen = (size_t)(base - gen->word);
+	blen = gen->len - dlen;
+
+	if (dlen) {
+		memcpy(cand, gen->word, dlen);
+		cand[dlen] = '\0';
+		fd = open(cand, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	}
+	else
+		fd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	dir = clui_shell_get_path_dir(fd);
+	if (!dir) {
+		ret = -errno;
+		goto close;
+	}
+
+	/*
+	 * Let readline know candidates are file names so that it does not
+	 * append a space to directories, which come with a trailing slash.
+	 * Quoting is useless since names holding blanks are skipped.
+	 */
+	rl_filename_completion_desired = 1;
+	rl_filename_quoting_desired = 0;
+
+	for (e = clui_shell_find_path_ent(dir, base, blen); e < dir->nr; e++) {
+		const struct clui_shell_path_ent * ent = &dir->ents[e];
+		const char *                       name = &dir->names[ent->name];
+		unsigned char                      type;
+		size_t                             len;
+
+		if (strncmp(name, base, blen))
+			break;
+
+		/* Hide dot files unless explicitly requested. */
+		if ((name[0] == '.') && !blen)
+			continue;
+
+		type = clui_shell_path_ent_type(fd, name, ent->type);
+		if (!clui_shell_path_type_ok(filter, name, ent->len, type))
+			continue;
+
+		len = dlen + ent->len;
+		if ((len + 1) >= sizeof(cand))
+			continue;
+
+		memcpy(&cand[dlen], name, ent->len);
+		if (type == DT_DIR)
+			cand[len++] = '/';
+
+		ret = clui_shell_yield(gen, cand, len);
+		if (ret)
+			break;
+	}
+
+close:
+	close(fd);
+
+	return ret;
+}
+
+char ** __clui_nonull(1)
+clui_shell_build_path_matches(const char *                          word,
+                              size_t                                len,
+                              const struct clui_shell_path_filter * filter)
+{
+	clui_assert(word);
+
+	return clui_shell_generate_matches(word,
+	                                   len,
+	                                   clui_shell_generate_paths,
+	                                   (void *)filter);
+}
+
+void
+clui_shell_clear_path_cache(void)
+{
+	struct clui_shell_path_cache * cache = &clui_shell_the_path_cache;
+	unsigned int                   d;
+
+	for (d = 0; d < array_nr(cache->dirs); d++)
+		clui_shell_clear_path_dir(&cache->dirs[d]);
+
+	cache->stamp = 0;
+}
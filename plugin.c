@@ -0,0 +1,146 @@
+#include <clui/plugin.h>
+#include <errno.h>
+#include <dlfcn.h>
+
+static const struct clui_plugin_desc *
+clui_plugin_open(const struct clui_plugin_cmd * plug, void ** handle)
+{
+	const struct clui_plugin_desc * desc;
+
+	*handle = dlopen(plug->path, RTLD_NOW | RTLD_LOCAL);
+	if (!*handle) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	desc = dlsym(*handle, plug->symbol);
+	if (!desc ||
+	    (desc->abi != CLUI_PLUGIN_ABI) ||
+	    !desc->cmd ||
+	    !desc->cmd->parse ||
+	    !desc->cmd->help) {
+		dlclose(*handle);
+		errno = ENOEXEC;
+		return NULL;
+	}
+
+	return desc;
+}
+
+const struct clui_plugin_desc * __clui_nonull(1)
+clui_plugin_load(const struct clui_plugin_cmd * plug,
+                 const struct clui_parser *     parser)
+{
+	clui_assert_plugin_cmd(plug);
+
+	struct clui_plugin_state *      state = plug->state;
+	const struct clui_plugin_desc * desc;
+	void *                          handle;
+	void *                          expected = NULL;
+
+	desc = __atomic_load_n(&state->desc, __ATOMIC_ACQUIRE);
+	if (desc)
+		return desc;
+
+	desc = clui_plugin_open(plug, &handle);
+	if (!desc) {
+		if (parser) {
+			int err = errno;
+
+			clui_err(parser,
+			         "%s: cannot load plugin: %s.\n",
+			         plug->label,
+			         (err == ENOENT) ? dlerror() :
+			                           "invalid plugin descriptor");
+			errno = err;
+		}
+
+		return NULL;
+	}
+
+	/*
+	 * Loading the same object concurrently gives the same handle and
+	 * descriptor back: just drop the extra reference.
+	 */
+	if (!__atomic_compare_exchange_n(&state->handle,
+	                                 &expected,
+	                                 handle,
+	                                 false,
+	                                 __ATOMIC_ACQ_REL,
+	                                 __ATOMIC_ACQUIRE))
+		dlclose(handle);
+
+	__atomic_store_n(&state->desc, desc, __ATOMIC_RELEASE);
+
+	return desc;
+}
+
+int
+clui_plugin_parse(const struct clui_cmd * cmd,
+                  struct clui_parser *    parser,
+                  int                     argc,
+                  char * const *          argv,
+                  void *                  ctx)
+{
+	const struct clui_plugin_desc * desc;
+
+	desc = clui_plugin_load(clui_plugin_from_cmd(cmd), parser);
+	if (!desc)
+		return -errno;
+
+	return clui_parse_cmd(desc->cmd, parser, argc, argv, ctx);
+}
+
+void
+clui_plugin_help(const struct clui_cmd *    cmd,
+                 const struct clui_parser * parser,
+                 FILE *                     stdio)
+{
+	const struct clui_plugin_cmd *  plug = clui_plugin_from_cmd(cmd);
+	const struct clui_plugin_desc * desc;
+
+	desc = clui_plugin_load(plug, NULL);
+	if (!desc) {
+		/* Plugin unavailable: fallback to stub summary. */
+		fprintf(stdio, "%s - %s\n", plug->label, plug->summary);
+		return;
+	}
+
+	clui_help_cmd(desc->cmd, parser, stdio);
+}
+
+char ** __clui_nonull(1, 2)
+clui_plugin_complete(const struct clui_plugin_cmd * plug,
+                     const char *                   word,
+                     size_t                         len,
+                     int                            argc,
+                     const char * const             argv[],
+                     void *                         data)
+{
+	clui_assert_plugin_cmd(plug);
+	clui_assert(word);
+
+	const struct clui_plugin_desc * desc;
+
+	desc = clui_plugin_load(plug, NULL);
+	if (!desc || !desc->complete)
+		return NULL;
+
+	return desc->complete(word, len, argc, argv, data);
+}
+
+void __clui_nonull(1)
+clui_plugin_unload(const struct clui_plugin_cmd * plug)
+{
+	clui_assert_plugin_cmd(plug);
+
+	void * handle;
+
+	__atomic_store_n(&plug->state->desc, NULL, __ATOMIC_RELEASE);
+
+	handle = __atomic_exchange_n(&plug->state->handle,
+	                             NULL,
+	                             __ATOMIC_ACQ_REL);
+	if (handle)
+		dlclose(handle);
+}
@@ -0,0 +1,155 @@
+#include "shell_priv.h"
+#include "record.h"
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+struct clui_shell_recorder {
+	FILE *           stdio;
+	struct timespec  last;
+	rl_getc_func_t * getc;
+	const char *     name;
+	const char *     prompt;
+	unsigned int     flags;
+};
+
+static struct clui_shell_recorder clui_the_recorder;
+
+static void
+clui_shell_record_varint(uint64_t val)
+{
+	uint8_t      buff[CLUI_RECORD_VARINT_MAX];
+	unsigned int len;
+
+	len = clui_record_encode_varint(buff, val);
+	fwrite(buff, 1, len, clui_the_recorder.stdio);
+}
+
+static void
+clui_shell_record_string(const char * str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	clui_shell_record_varint(len);
+	fwrite(str, 1, len, clui_the_recorder.stdio);
+}
+
+void
+clui_shell_record(unsigned int type, const char * data, size_t len)
+{
+	struct timespec now;
+	uint64_t        delta;
+
+	if (!clui_the_recorder.stdio)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	delta = ((now.tv_sec - clui_the_recorder.last.tv_sec) * 1000000LL) +
+	        ((now.tv_nsec - clui_the_recorder.last.tv_nsec) / 1000);
+	clui_the_recorder.last = now;
+
+	putc(type, clui_the_recorder.stdio);
+	clui_shell_record_varint(delta);
+	clui_shell_record_varint(len);
+	fwrite(data, 1, len, clui_the_recorder.stdio);
+
+	if (type == CLUI_RECORD_EXPR_TYPE)
+		fflush(clui_the_recorder.stdio);
+}
+
+static int
+clui_shell_record_getc(FILE * stream)
+{
+	int chr;
+
+	chr = clui_the_recorder.getc(stream);
+	if ((chr >= 0) && (chr <= UCHAR_MAX)) {
+		char byte = (char)chr;
+
+		clui_shell_record(CLUI_RECORD_INPUT_TYPE, &byte, 1);
+	}
+
+	return chr;
+}
+
+int __clui_nonull(1)
+clui_shell_start_record(const char * path)
+{
+	clui_assert(path);
+	clui_assert(*path);
+
+	FILE * stdio;
+
+	if (clui_the_recorder.stdio)
+		return -EBUSY;
+
+	stdio = fopen(path, "we");
+	if (!stdio)
+		return -errno;
+
+	clui_the_recorder.stdio = stdio;
+
+	fwrite(CLUI_RECORD_MAGIC, 1, sizeof(CLUI_RECORD_MAGIC) - 1, stdio);
+	putc(CLUI_RECORD_VERSION, stdio);
+	putc(clui_the_recorder.flags, stdio);
+	clui_shell_record_string(clui_the_recorder.name);
+	clui_shell_record_string(clui_the_recorder.prompt);
+	if (fflush(stdio)) {
+		int err = errno;
+
+		fclose(stdio);
+		clui_the_recorder.stdio = NULL;
+
+		return -err;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &clui_the_recorder.last);
+
+	/* Intercept input characters as fetched by readline. */
+	clui_the_recorder.getc = rl_getc_function;
+	rl_getc_function = clui_shell_record_getc;
+
+	return 0;
+}
+
+void
+clui_shell_stop_record(void)
+{
+	if (!clui_the_recorder.stdio)
+		return;
+
+	rl_getc_function = clui_the_recorder.getc;
+
+	fclose(clui_the_recorder.stdio);
+	clui_the_recorder.stdio = NULL;
+}
+
+void __clui_nonull(1)
+clui_shell_install_getc(rl_getc_func_t * getc)
+{
+	clui_assert(getc);
+
+	if (clui_the_recorder.stdio)
+		clui_the_recorder.getc = getc;
+	else
+		rl_getc_function = getc;
+}
+
+void
+clui_shell_init_record(const char * name,
+                       const char * prompt,
+                       unsigned int flags)
+{
+	const char * path;
+
+	clui_the_recorder.name = name;
+	clui_the_recorder.prompt = prompt;
+	clui_the_recorder.flags = flags;
+
+	/* Allow operators to record sessions without application support. */
+	path = secure_getenv("CLUI_SHELL_RECORD");
+	if (path && *path)
+		clui_shell_start_record(path);
+}
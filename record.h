@@ -0,0 +1,73 @@
+#ifndef _CLUI_RECORD_H
+#define _CLUI_RECORD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Session recording file format.
+ *
+ * Header:
+ *   magic[4], version:u8, flags:u8, name_len:varint, name,
+ *   prompt_len:varint, prompt
+ * followed by records:
+ *   type:u8, delta_usec:varint, len:varint, data
+ *
+ * where varint is an unsigned LEB128 encoded integer and delta_usec the
+ * number of microseconds elapsed since previous record.
+ */
+#define CLUI_RECORD_MAGIC         "CLRC"
+#define CLUI_RECORD_VERSION       (1U)
+
+#define CLUI_RECORD_HIST_FLAG     (1U << 0)
+#define CLUI_RECORD_COMPLETE_FLAG (1U << 1)
+
+/* Input bytes as read by readline. */
+#define CLUI_RECORD_INPUT_TYPE    (1U)
+/* Completion request: line content up to the cursor. */
+#define CLUI_RECORD_COMPLETE_TYPE (2U)
+/* Accepted expression. */
+#define CLUI_RECORD_EXPR_TYPE     (3U)
+
+#define CLUI_RECORD_VARINT_MAX    (10U)
+
+static inline unsigned int
+clui_record_encode_varint(uint8_t buff[CLUI_RECORD_VARINT_MAX], uint64_t val)
+{
+	unsigned int cnt = 0;
+
+	do {
+		buff[cnt] = val & 0x7f;
+		val >>= 7;
+		if (val)
+			buff[cnt] |= 0x80;
+		cnt++;
+	} while (val);
+
+	return cnt;
+}
+
+static inline int
+clui_record_load_varint(FILE * stdio, uint64_t * val)
+{
+	unsigned int shift = 0;
+
+	*val = 0;
+	do {
+		int byte;
+
+		byte = getc(stdio);
+		if (byte == EOF)
+			return -1;
+
+		*val |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return 0;
+
+		shift += 7;
+	} while (shift < (7 * CLUI_RECORD_VARINT_MAX));
+
+	return -1;
+}
+
+#endif /* _CLUI_RECORD_H */
@@ -1,56 +1,876 @@
-#include <clui/clui.h>
-#include <clui/shell.h>
+#include "shell_priv.h"
+#include "record.h"
+#include "mem_priv.h"
 #include <utils/string.h>
 #include <utils/path.h>
+#if defined(CONFIG_CLUI_SHELL_STATIC)
+#include <ctype.h>
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
 #include <utils/bitmap.h>
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
+#include <wchar.h>
+#include <limits.h>
 #include <signal.h>
 #include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#if defined(CONFIG_CLUI_SHELL_LAZY_HIST)
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif /* defined(CONFIG_CLUI_SHELL_LAZY_HIST) */
 #include <readline/readline.h>
 #include <readline/history.h>
 
 struct clui_shell {
-	size_t                   match_len;
-	unsigned int             match_indx;
-	unsigned int             match_nr;
-	const char * const *     matches;
 	clui_shell_complete_fn * complete;
 	void *                   data;
 	const char *             prompt;
 	bool                     hist;
 	char *                   hist_path;
+	char                     hist_file[PATH_MAX];
 	volatile sig_atomic_t    redisplay;
 	volatile sig_atomic_t    shutdown;
+	int                      evfd;
 };
 
-static struct clui_shell clui_the_shell;
+static struct clui_shell clui_the_shell = { .evfd = -1 };
 
-static char * __clui_nonull(1) __nothrow
-clui_shell_generate_static_match(const char * restrict word, int state __unused)
+/*
+ * Wake up shell waiting for input so that it processes pending events, see
+ * clui_shell_getc().
+ * May be called from signal handlers and threads.
+ */
+static void
+clui_shell_notify(void)
 {
-	clui_assert(word);
-	clui_assert(!(!!state ^ !!clui_the_shell.match_indx));
-	clui_assert(clui_the_shell.match_nr);
-	clui_assert(clui_the_shell.matches);
+	if (clui_the_shell.evfd >= 0) {
+		const uint64_t val = 1;
+		int            err = errno;
+		ssize_t        ret __unused;
+
+		/* Counter overflow is harmless since fd stays readable. */
+		ret = write(clui_the_shell.evfd, &val, sizeof(val));
+		clui_assert((ret == sizeof(val)) ||
+		            (errno == EAGAIN) ||
+		            (errno == EINTR));
+
+		errno = err;
+	}
+}
 
-	while (clui_the_shell.match_indx < clui_the_shell.match_nr) {
-		const char * match =
-			clui_the_shell.matches[clui_the_shell.match_indx];
+/*
+ * Messages printed using clui_shell_print() are queued by producer threads
+ * then written out above the prompt by the thread running the shell, in
+ * batches so that a burst of messages costs a single prompt redraw.
+ * Messages are formatted into one buffer while the other one is being
+ * written out.
+ */
+#define CLUI_SHELL_PRINT_SIZE   CONFIG_CLUI_SHELL_PRINT_SIZE
+
+/* Minimum delay between batches in milliseconds. */
+#define CLUI_SHELL_PRINT_PERIOD (1000L / CONFIG_CLUI_SHELL_PRINT_RATE)
+
+struct clui_shell_print_queue {
+	pthread_mutex_t lock;
+	bool            pending;
+	char *          buff;
+	size_t          len;
+	unsigned long   dropped;
+	long            last;
+	char            bufs[2][CLUI_SHELL_PRINT_SIZE];
+};
 
-		if (!match)
+static struct clui_shell_print_queue clui_the_prints = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.buff = clui_the_prints.bufs[0]
+};
+
+/*
+ * Flag pending batch. Notify the shell only upon the first message of a
+ * batch so that subsequent ones cost no syscall.
+ * Must be called with queue lock held.
+ */
+static bool
+clui_shell_mark_prints(struct clui_shell_print_queue * queue)
+{
+	if (queue->pending)
+		return false;
+
+	__atomic_store_n(&queue->pending, true, __ATOMIC_RELAXED);
+
+	return true;
+}
+
+void
+clui_shell_schedule_prints(void)
+{
+	bool notify;
+
+	pthread_mutex_lock(&clui_the_prints.lock);
+	notify = clui_shell_mark_prints(&clui_the_prints);
+	pthread_mutex_unlock(&clui_the_prints.lock);
+
+	if (notify)
+		clui_shell_notify();
+}
+
+int __clui_nonull(1) __printf(1, 0)
+clui_shell_vprint(const char * format, va_list args)
+{
+	clui_assert(format);
+
+	struct clui_shell_print_queue * queue = &clui_the_prints;
+	size_t                          room;
+	bool                            notify;
+	int                             ret;
+
+	pthread_mutex_lock(&queue->lock);
+
+	room = sizeof(queue->bufs[0]) - queue->len;
+	ret = vsnprintf(&queue->buff[queue->len], room, format, args);
+	if (ret < 0) {
+		ret = -errno;
+		goto unlock;
+	}
+
+	/*
+	 * Terminating NUL byte is not needed once queued: its slot is left for
+	 * the line feed appended to unterminated messages.
+	 */
+	if ((size_t)ret >= room) {
+		queue->dropped++;
+		ret = -ENOBUFS;
+	}
+	else if (ret) {
+		if (queue->buff[queue->len + ret - 1] != '\n')
+			queue->buff[queue->len + ret++] = '\n';
+		queue->len += ret;
+	}
+	else
+		goto unlock;
+
+	notify = clui_shell_mark_prints(queue);
+
+	pthread_mutex_unlock(&queue->lock);
+
+	if (notify)
+		clui_shell_notify();
+
+	return ret;
+
+unlock:
+	pthread_mutex_unlock(&queue->lock);
+
+	return ret;
+}
+
+int __clui_nonull(1) __printf(1, 2)
+clui_shell_print(const char * format, ...)
+{
+	clui_assert(format);
+
+	va_list args;
+	int     ret;
+
+	va_start(args, format);
+	ret = clui_shell_vprint(format, args);
+	va_end(args);
+
+	return ret;
+}
+
+static long
+clui_shell_print_clock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec * 1000L) + (now.tv_nsec / 1000000L);
+}
+
+/*
+ * Return the number of milliseconds to wait for before next batch may be
+ * written out, 0 meaning now and -1 that no batch is pending.
+ */
+static int
+clui_shell_print_delay(void)
+{
+	long delay;
+
+	if (!__atomic_load_n(&clui_the_prints.pending, __ATOMIC_RELAXED))
+		return -1;
+
+	delay = clui_the_prints.last + CLUI_SHELL_PRINT_PERIOD -
+	        clui_shell_print_clock();
+
+	return (delay > 0) ? (int)delay : 0;
+}
+
+/*
+ * Write out pending batch, preceded by dropped messages count if any, then
+ * background job notices.
+ */
+static void
+clui_shell_write_prints(void)
+{
+	struct clui_shell_print_queue * queue = &clui_the_prints;
+	const char *                    batch;
+	size_t                          len;
+	unsigned long                   dropped;
+
+	/* Hand the other buffer over to producers. */
+	pthread_mutex_lock(&queue->lock);
+
+	batch = queue->buff;
+	len = queue->len;
+	dropped = queue->dropped;
+
+	queue->buff = (batch == queue->bufs[0]) ? queue->bufs[1] :
+	                                          queue->bufs[0];
+	queue->len = 0;
+	queue->dropped = 0;
+	__atomic_store_n(&queue->pending, false, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(&queue->lock);
+
+	if (dropped)
+		printf("%lu message(s) dropped.\n", dropped);
+	if (len)
+		fwrite(batch, 1, len, stdout);
+
+	/* Tell user about background jobs completed since last batch. */
+	clui_shell_report_jobs();
+
+	fflush(stdout);
+}
+
+/*
+ * Write pending batch out above the prompt and redraw prompt and line being
+ * typed once, whatever the number of messages.
+ */
+static void
+clui_shell_redraw_prints(void)
+{
+	rl_clear_visible_line();
+	clui_shell_write_prints();
+	rl_forced_update_display();
+
+	clui_the_prints.last = clui_shell_print_clock();
+}
+
+/*
+ * Candidates of the last matches array built by clui_shell_generate_matches()
+ * so that clui_shell_display_matches() may reuse their lengths to lay them
+ * out.
+ */
+struct clui_shell_match_cache {
+	char * const *           matches;
+	unsigned int             nr;
+	struct clui_shell_cand * cands;
+};
+
+static struct clui_shell_match_cache clui_shell_the_cache;
+
+#if defined(CONFIG_CLUI_SHELL_STATIC)
+
+/* Default and highest maximum number of completion candidates. */
+#define CLUI_SHELL_MATCH_MAX_DEFAULT ((unsigned int)CONFIG_CLUI_SHELL_MATCH_MAX)
+#define CLUI_SHELL_MATCH_MAX_LIMIT   ((unsigned int)CONFIG_CLUI_SHELL_MATCH_MAX)
+
+/*
+ * Completion candidates are stored into fixed size buffers reused by every
+ * completion request. These are never handed over to readline since it would
+ * free(3) them, see clui_shell_complete_key().
+ */
+static struct clui_shell_cand clui_shell_match_cands[CONFIG_CLUI_SHELL_MATCH_MAX];
+static char *                 clui_shell_match_ptrs[CONFIG_CLUI_SHELL_MATCH_MAX + 2];
+static char                   clui_shell_match_chars[CONFIG_CLUI_SHELL_MATCH_CHARS];
+static char                   clui_shell_match_lcd[LINE_MAX];
+
+static void
+clui_shell_init_gen_cands(struct clui_shell_gen * gen)
+{
+	gen->cands = clui_shell_match_cands;
+	gen->size = array_nr(clui_shell_match_cands);
+	gen->used = 0;
+}
+
+static int
+clui_shell_store_cand(struct clui_shell_gen * gen,
+                      unsigned int            slot,
+                      const char *            cand,
+                      size_t                  len)
+{
+	clui_assert(slot < gen->size);
+
+	char * str;
+
+	if ((gen->used + len) >= sizeof(clui_shell_match_chars)) {
+		/* Out of room: behave as if maximum count was reached. */
+		gen->truncated = true;
+		return -ENOSPC;
+	}
+
+	str = &clui_shell_match_chars[gen->used];
+	memcpy(str, cand, len);
+	str[len] = '\0';
+	gen->used += len + 1;
+
+	gen->cands[slot].str = str;
+	gen->cands[slot].len = len;
+
+	return 0;
+}
+
+static void
+clui_shell_drop_cand(const struct clui_shell_cand * cand __unused)
+{
+}
+
+static char **
+clui_shell_alloc_matches(const struct clui_shell_gen * gen __unused)
+{
+	return clui_shell_match_ptrs;
+}
+
+static char *
+clui_shell_store_lcd(const char * str, size_t len)
+{
+	len = min(len, sizeof(clui_shell_match_lcd) - 1);
+
+	memcpy(clui_shell_match_lcd, str, len);
+	clui_shell_match_lcd[len] = '\0';
+
+	return clui_shell_match_lcd;
+}
+
+static void
+clui_shell_free_matches(char ** matches __unused)
+{
+}
+
+static void
+clui_shell_disown_matches(char ** matches __unused)
+{
+}
+
+static void
+clui_shell_free_cands(struct clui_shell_cand * cands __unused)
+{
+}
+
+static void
+clui_shell_release_gen_cands(const struct clui_shell_gen * gen __unused)
+{
+}
+
+static void
+clui_shell_clear_match_cache(void)
+{
+	clui_shell_the_cache.matches = NULL;
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
+
+/* Default and highest maximum number of completion candidates. */
+#define CLUI_SHELL_MATCH_MAX_DEFAULT (1024U)
+#define CLUI_SHELL_MATCH_MAX_LIMIT   (UINT_MAX - 2)
+
+static void
+clui_shell_init_gen_cands(struct clui_shell_gen * gen)
+{
+	gen->cands = NULL;
+	gen->size = 0;
+	gen->used = 0;
+}
+
+static int
+clui_shell_store_cand(struct clui_shell_gen * gen,
+                      unsigned int            slot,
+                      const char *            cand,
+                      size_t                  len)
+{
+	clui_assert(slot <= gen->size);
+
+	char * str;
+
+	if (slot == gen->size) {
+		unsigned int             size = gen->size ? (2 * gen->size) : 16;
+		struct clui_shell_cand * tmp;
+
+		tmp = clui_mem_realloc(CLUI_MEM_CMPL_SYS,
+		                       gen->cands,
+		                       size * sizeof(tmp[0]));
+		if (!tmp)
+			return -ENOMEM;
+
+		gen->cands = tmp;
+		gen->size = size;
+	}
+
+	str = clui_mem_strndup(CLUI_MEM_CMPL_SYS, cand, len);
+	if (!str)
+		return -ENOMEM;
+
+	gen->cands[slot].str = str;
+	gen->cands[slot].len = len;
+
+	return 0;
+}
+
+static void
+clui_shell_drop_cand(const struct clui_shell_cand * cand)
+{
+	clui_mem_free(CLUI_MEM_CMPL_SYS, cand->str);
+}
+
+static char **
+clui_shell_alloc_matches(const struct clui_shell_gen * gen)
+{
+	/*
+	 * Slot 0 is reserved for the substitution text, and the array is NULL
+	 * terminated, as readline expects.
+	 */
+	return clui_mem_alloc(CLUI_MEM_CMPL_SYS, (gen->nr + 2) * sizeof(char *));
+}
+
+static char *
+clui_shell_store_lcd(const char * str, size_t len)
+{
+	return clui_mem_strndup(CLUI_MEM_CMPL_SYS, str, len);
+}
+
+static void
+clui_shell_free_matches(char ** matches)
+{
+	clui_mem_free(CLUI_MEM_CMPL_SYS, matches);
+}
+
+/* Matches returned to readline are free(3)'d by the latter. */
+static void
+clui_shell_disown_matches(char ** matches)
+{
+	char ** m;
+
+	for (m = matches; *m; m++)
+		clui_mem_disown(CLUI_MEM_CMPL_SYS, *m);
+	clui_mem_disown(CLUI_MEM_CMPL_SYS, matches);
+}
+
+static void
+clui_shell_free_cands(struct clui_shell_cand * cands)
+{
+	clui_mem_free(CLUI_MEM_CMPL_SYS, cands);
+}
+
+static void
+clui_shell_release_gen_cands(const struct clui_shell_gen * gen)
+{
+	unsigned int c;
+
+	for (c = 0; c < gen->nr; c++)
+		clui_mem_free(CLUI_MEM_CMPL_SYS, gen->cands[c].str);
+	clui_shell_free_cands(gen->cands);
+}
+
+static void
+clui_shell_clear_match_cache(void)
+{
+	/* Candidate strings are owned by readline: release the array only. */
+	clui_shell_free_cands(clui_shell_the_cache.cands);
+
+	clui_shell_the_cache.matches = NULL;
+	clui_shell_the_cache.cands = NULL;
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
+
+static bool clui_shell_fuzzy;
+
+void
+clui_shell_set_fuzzy_matching(bool on)
+{
+	clui_shell_fuzzy = on;
+}
+
+/* Bonus granted to candidates starting with the word to complete. */
+#define CLUI_SHELL_FUZZY_PREFIX (1024)
+
+/* Number of leading candidate characters scanned for fuzzy matching. */
+#define CLUI_SHELL_FUZZY_SCAN   (256U)
+
+static bool
+clui_shell_fuzzy_bound(const char * cand, size_t pos)
+{
+	return !pos || strchr("-_./:", cand[pos - 1]);
+}
+
+/*
+ * Match candidate against the word to complete as a subsequence, greedily
+ * picking the leftmost occurrence of each character. These are located
+ * using memchr(3), which the C library vectorizes, and the scan is bounded
+ * to the first CLUI_SHELL_FUZZY_SCAN characters so that cost does not depend
+ * on candidate length.
+ * Matched characters are rewarded, more so when contiguous or at the start
+ * of a candidate word, gaps and trailing characters are penalized.
+ */
+static bool
+clui_shell_score_cand(const char * word,
+                      size_t       wlen,
+                      const char * cand,
+                      size_t       len,
+                      int *        score)
+{
+	size_t end = min(len, (size_t)CLUI_SHELL_FUZZY_SCAN);
+	size_t pos = 0;
+	size_t w;
+	int    sc = 0;
+
+	if (!strncmp(word, cand, min(wlen, len)) && (wlen <= len))
+		sc += CLUI_SHELL_FUZZY_PREFIX;
+
+	for (w = 0; w < wlen; w++) {
+		const char * hit;
+		size_t       p;
+
+		hit = memchr(&cand[pos], word[w], end - pos);
+		if (!hit)
+			return false;
+
+		p = (size_t)(hit - cand);
+
+		sc += 16;
+		if (w && (p == pos))
+			sc += 8;
+		if (clui_shell_fuzzy_bound(cand, p))
+			sc += 8;
+		sc -= (int)min(p - pos, (size_t)8);
+
+		pos = p + 1;
+	}
+
+	*score = sc - (int)min(len - wlen, (size_t)16);
+
+	return true;
+}
+
+/* Min-heap of candidates by score, used once maximum count is reached. */
+static void
+clui_shell_sift_cands(struct clui_shell_gen * gen, unsigned int c)
+{
+	struct clui_shell_cand * cands = gen->cands;
+
+	while (true) {
+		unsigned int low = c;
+		unsigned int child = (2 * c) + 1;
+		struct clui_shell_cand tmp;
+
+		if ((child < gen->nr) && (cands[child].score < cands[low].score))
+			low = child;
+		child++;
+		if ((child < gen->nr) && (cands[child].score < cands[low].score))
+			low = child;
+
+		if (low == c)
 			break;
 
-		clui_the_shell.match_indx++;
+		tmp = cands[c];
+		cands[c] = cands[low];
+		cands[low] = tmp;
+		c = low;
+	}
+}
+
+/*
+ * Keep best ranked fuzzy matches only: replace the lowest scored candidate
+ * when the new one scores better.
+ */
+static int
+clui_shell_rank_cand(struct clui_shell_gen * gen,
+                     const char *            cand,
+                     size_t                  len,
+                     int                     score)
+{
+	struct clui_shell_cand old;
+	int                    ret;
+
+	if (!gen->truncated) {
+		unsigned int c;
+
+		for (c = gen->nr / 2; c-- > 0; )
+			clui_shell_sift_cands(gen, c);
+		gen->truncated = true;
+	}
+
+	if (score <= gen->cands[0].score)
+		return 0;
 
-		if (!strncmp(word, match, clui_the_shell.match_len))
-			return strdup(match);
+	old = gen->cands[0];
+	ret = clui_shell_store_cand(gen, 0, cand, len);
+	if (ret) {
+		gen->cands[0] = old;
+		return ret;
 	}
+	clui_shell_drop_cand(&old);
+
+	gen->cands[0].score = score;
+	clui_shell_sift_cands(gen, 0);
+
+	return 0;
+}
+
+int __clui_nonull(1, 2)
+clui_shell_yield(struct clui_shell_gen * gen, const char * cand, size_t len)
+{
+	clui_assert(gen);
+	clui_assert(cand);
+
+	size_t l;
+	int    score = 0;
+	int    ret;
+
+	if (clui_shell_fuzzy) {
+		if (!clui_shell_score_cand(gen->word,
+		                           gen->len,
+		                           cand,
+		                           len,
+		                           &score))
+			return 0;
+
+		/* Candidate does not start with the word to complete. */
+		if ((len < gen->len) || strncmp(gen->word, cand, gen->len))
+			gen->fuzzy = true;
+
+		if (gen->nr == gen->max)
+			return clui_shell_rank_cand(gen, cand, len, score);
+	}
+	else {
+		/* Filter out candidates not matching the word to complete. */
+		if ((len < gen->len) || strncmp(gen->word, cand, gen->len))
+			return 0;
+
+		if (gen->nr == gen->max) {
+			/* Tell provider to stop producing candidates. */
+			gen->truncated = true;
+			return -ENOSPC;
+		}
+	}
+
+	ret = clui_shell_store_cand(gen, gen->nr, cand, len);
+	if (ret)
+		return ret;
+
+	gen->cands[gen->nr].score = score;
+
+	/*
+	 * Update lowest common denominator of candidates found so far. It is
+	 * meaningless as soon as a candidate does not start with the word to
+	 * complete.
+	 */
+	if (gen->fuzzy)
+		gen->lcd = gen->len;
+	else if (gen->nr) {
+		const char * first = gen->cands[0].str;
+
+		for (l = gen->len;
+		     (l < gen->lcd) && (l < len) && (first[l] == cand[l]);
+		     l++)
+			;
+		gen->lcd = l;
+	}
+	else
+		gen->lcd = len;
+
+	gen->nr++;
+
+	return 0;
+}
+
+static unsigned int clui_shell_match_max = CLUI_SHELL_MATCH_MAX_DEFAULT;
+
+void
+clui_shell_set_max_matches(unsigned int max)
+{
+	clui_shell_match_max = (max && (max < CLUI_SHELL_MATCH_MAX_LIMIT)) ?
+	                       max : CLUI_SHELL_MATCH_MAX_LIMIT;
+}
+
+static int
+clui_shell_cmp_cands(const void * first, const void * second)
+{
+	return strcmp(((const struct clui_shell_cand *)first)->str,
+	              ((const struct clui_shell_cand *)second)->str);
+}
+
+static int
+clui_shell_rank_cands(const void * first, const void * second)
+{
+	const struct clui_shell_cand * fst = first;
+	const struct clui_shell_cand * snd = second;
+
+	if (fst->score != snd->score)
+		return (fst->score > snd->score) ? -1 : 1;
+
+	return strcmp(fst->str, snd->str);
+}
+
+/*
+ * Sort candidates and remove duplicates. Fuzzy matches are then ordered by
+ * decreasing score.
+ */
+static void
+clui_shell_sort_cands(struct clui_shell_gen * gen)
+{
+	unsigned int c;
+	unsigned int nr = 1;
+
+	qsort(gen->cands, gen->nr, sizeof(gen->cands[0]), clui_shell_cmp_cands);
+
+	for (c = 1; c < gen->nr; c++) {
+		if (strcmp(gen->cands[c].str, gen->cands[nr - 1].str))
+			gen->cands[nr++] = gen->cands[c];
+		else
+			clui_shell_drop_cand(&gen->cands[c]);
+	}
+
+	gen->nr = nr;
+
+	if (gen->fuzzy)
+		qsort(gen->cands,
+		      gen->nr,
+		      sizeof(gen->cands[0]),
+		      clui_shell_rank_cands);
+}
+
+char ** __clui_nonull(1, 3)
+clui_shell_generate_matches(const char *        word,
+                            size_t              len,
+                            clui_shell_gen_fn * generate,
+                            void *              data)
+{
+	clui_assert(word);
+	clui_assert(generate);
+
+	struct clui_shell_gen gen = {
+		.word      = word,
+		.len       = len,
+		.nr        = 0,
+		.max       = clui_shell_match_max,
+		.lcd       = 0,
+		.truncated = false,
+		.fuzzy     = false
+	};
+	char **               matches;
+	unsigned int          c;
+
+	if (len >= (LINE_MAX - 1))
+		return NULL;
+
+	clui_assert(strnlen(word, LINE_MAX) == len);
+
+	clui_shell_init_gen_cands(&gen);
+
+	if (generate(&gen, data) && !gen.truncated)
+		/* Provider failure other than early stop. */
+		goto release;
+
+	if (!gen.nr)
+		goto release;
+
+	clui_shell_sort_cands(&gen);
+
+	matches = clui_shell_alloc_matches(&gen);
+	if (!matches)
+		goto release;
+
+	if ((gen.nr == 1) && !gen.truncated) {
+		/*
+		 * Single match: substitute it to the word to complete. A
+		 * single retained candidate out of a truncated list is not
+		 * unique and is handled as multiple matches below.
+		 */
+		matches[0] = gen.cands[0].str;
+		matches[1] = NULL;
+
+		clui_shell_free_cands(gen.cands);
+		clui_shell_disown_matches(matches);
+
+		return matches;
+	}
+
+	/*
+	 * Don't substitute anything longer than the word itself when the
+	 * candidates list is truncated since the common prefix of all
+	 * candidates is not known, nor when they don't all start with the word.
+	 */
+	if (gen.fuzzy)
+		matches[0] = clui_shell_store_lcd(gen.word, gen.len);
+	else
+		matches[0] = clui_shell_store_lcd(gen.cands[0].str,
+		                                  gen.truncated ? gen.len :
+		                                                  gen.lcd);
+	if (!matches[0])
+		goto free;
+
+	for (c = 0; c < gen.nr; c++)
+		matches[c + 1] = gen.cands[c].str;
+	matches[gen.nr + 1] = NULL;
+
+	/* Candidates are already sorted and unique: spare readline the job. */
+	rl_sort_completion_matches = 0;
+	rl_ignore_completion_duplicates = 0;
+
+	clui_shell_clear_match_cache();
+	clui_shell_the_cache.matches = matches;
+	clui_shell_the_cache.nr = gen.nr;
+	clui_shell_the_cache.cands = gen.cands;
+
+	clui_shell_disown_matches(matches);
+
+	return matches;
+
+free:
+	clui_shell_free_matches(matches);
+release:
+	clui_shell_release_gen_cands(&gen);
 
 	return NULL;
 }
 
+struct clui_shell_static_gen {
+	const char * const * matches;
+	size_t               nr;
+};
+
+static int
+clui_shell_generate_static_matches(struct clui_shell_gen * gen, void * data)
+{
+	const struct clui_shell_static_gen * sgen = data;
+	size_t                               m;
+
+	for (m = 0; m < sgen->nr; m++) {
+		const char * match = sgen->matches[m];
+		int          ret;
+
+		if (!match)
+			break;
+
+		ret = clui_shell_yield(gen, match, strlen(match));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 char ** __clui_nonull(1, 3)
 clui_shell_build_static_matches(const char *       word,
                                 size_t             len,
@@ -61,19 +881,118 @@ clui_shell_build_static_matches(const char *       word,
 	clui_assert(matches);
 	clui_assert(nr);
 
-	if (len >= (LINE_MAX - 1))
-		return NULL;
+	struct clui_shell_static_gen sgen = {
+		.matches = matches,
+		.nr      = nr
+	};
 
-	clui_assert(strnlen(word, LINE_MAX) == len);
+	return clui_shell_generate_matches(word,
+	                                   len,
+	                                   clui_shell_generate_static_matches,
+	                                   &sgen);
+}
+
+/*
+ * Set of parameters still available for completion, along with room for
+ * their labels.
+ */
+#if defined(CONFIG_CLUI_SHELL_STATIC)
+
+struct clui_shell_parm_set {
+	unsigned int nr;
+	bool         avail[CONFIG_CLUI_SHELL_PARM_MAX];
+	const char * samples[CONFIG_CLUI_SHELL_PARM_MAX];
+};
+
+static int
+clui_shell_init_parm_set(struct clui_shell_parm_set * set, unsigned int nr)
+{
+	if (nr > array_nr(set->avail))
+		return -E2BIG;
+
+	set->nr = nr;
+	memset(set->avail, true, nr * sizeof(set->avail[0]));
+
+	return 0;
+}
+
+static void
+clui_shell_clear_parm(struct clui_shell_parm_set * set, unsigned int parm)
+{
+	set->avail[parm] = false;
+}
+
+static bool
+clui_shell_test_parm(const struct clui_shell_parm_set * set,
+                     unsigned int                       parm)
+{
+	return set->avail[parm];
+}
+
+static void
+clui_shell_fini_parm_set(struct clui_shell_parm_set * set __unused)
+{
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
+
+struct clui_shell_parm_set {
+	unsigned int  nr;
+	struct fbmp   avail;
+	const char ** samples;
+};
+
+/* Size of bitmap words fbmp_init_set() allocates. */
+static size_t
+clui_shell_parm_set_size(unsigned int nr)
+{
+	return ((nr + (CHAR_BIT * sizeof(unsigned long)) - 1) /
+	        (CHAR_BIT * sizeof(unsigned long))) * sizeof(unsigned long);
+}
+
+static int
+clui_shell_init_parm_set(struct clui_shell_parm_set * set, unsigned int nr)
+{
+	if (fbmp_init_set(&set->avail, nr))
+		return -ENOMEM;
+
+	set->samples = clui_mem_alloc(CLUI_MEM_CMPL_SYS,
+	                              nr * sizeof(set->samples[0]));
+	if (!set->samples) {
+		fbmp_fini(&set->avail);
+		return -ENOMEM;
+	}
+
+	clui_mem_account(CLUI_MEM_CMPL_SYS, clui_shell_parm_set_size(nr));
+
+	set->nr = nr;
+
+	return 0;
+}
+
+static void
+clui_shell_clear_parm(struct clui_shell_parm_set * set, unsigned int parm)
+{
+	fbmp_clear(&set->avail, parm);
+}
 
-	clui_the_shell.match_len = len;
-	clui_the_shell.match_indx = 0;
-	clui_the_shell.matches = matches;
-	clui_the_shell.match_nr = nr;
+static bool
+clui_shell_test_parm(const struct clui_shell_parm_set * set,
+                     unsigned int                       parm)
+{
+	return fbmp_test(&set->avail, parm);
+}
 
-	return rl_completion_matches(word, clui_shell_generate_static_match);
+static void
+clui_shell_fini_parm_set(struct clui_shell_parm_set * set)
+{
+	clui_mem_free(CLUI_MEM_CMPL_SYS, set->samples);
+	fbmp_fini(&set->avail);
+	clui_mem_unaccount(CLUI_MEM_CMPL_SYS, clui_shell_parm_set_size(set->nr));
 }
 
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
+
 static int __clui_nonull(1, 3) __nothrow __clui_pure
 clui_shell_find_kword_parm(
 	const struct clui_shell_kword_parm * const restrict parms[],
@@ -116,162 +1035,734 @@ clui_shell_build_kword_matches(
 	const char * const                         argv[],
 	void *                                     data)
 {
-	clui_assert(word);
-	clui_assert(parms);
-	clui_assert(nr);
-	clui_assert(argv);
+	clui_assert(word);
+	clui_assert(parms);
+	clui_assert(nr);
+	clui_assert(argv);
+
+	struct clui_shell_parm_set set;
+	int                        p = -ENOENT;
+	char **                    matches = NULL;
+
+	if (clui_shell_init_parm_set(&set, nr))
+		return NULL;
+
+	if (argc > 0) {
+		int a;
+
+		for (a = 0; a < (argc - 1); a += 2) {
+			p = clui_shell_find_kword_parm(parms, nr, argv[a]);
+			if (p >= 0)
+				clui_shell_clear_parm(&set, p);
+		}
+
+		p = clui_shell_find_kword_parm(parms, nr, argv[argc - 1]);
+	}
+
+	clui_assert(p < (int)nr);
+
+	if (!(argc % 2)) {
+		unsigned int m = 0;
+
+		if (p >= 0)
+			clui_shell_clear_parm(&set, p);
+
+		for (p = 0; p < (int)nr; p++) {
+			if (!clui_shell_test_parm(&set, p))
+				continue;
+
+			clui_assert(parms[p]);
+			clui_assert(parms[p]->clui);
+			clui_assert(parms[p]->clui->label);
+
+			set.samples[m++] = parms[p]->clui->label;
+		}
+
+		if (m)
+			matches = clui_shell_build_static_matches(word,
+			                                          len,
+			                                          set.samples,
+			                                          m);
+	}
+	else if ((p >= 0) && clui_shell_test_parm(&set, p)) {
+		clui_assert(parms[p]);
+		clui_assert(parms[p]->clui);
+		clui_assert(parms[p]->clui->label);
+
+		if (parms[p]->gen)
+			matches = clui_shell_generate_matches(word,
+			                                      len,
+			                                      parms[p]->gen,
+			                                      data);
+		else if (parms[p]->build)
+			matches = parms[p]->build(word, len, data);
+		else
+			matches = NULL;
+	}
+
+	clui_shell_fini_parm_set(&set);
+
+	return matches;
+}
+
+static int __clui_nonull(1, 3) __nothrow __clui_pure
+clui_shell_find_switch_parm(
+	const struct clui_switch_parm * const restrict parms[],
+	unsigned int                                   nr,
+	const char *                                   arg)
+{
+	clui_assert(parms);
+	clui_assert(nr);
+	clui_assert(arg);
+
+	if (*arg) {
+		unsigned int p;
+
+		for (p = 0; p < nr; p++) {
+			const struct clui_switch_parm * parm = parms[p];
+
+			clui_assert(parm);
+			clui_assert(parm->label);
+			clui_assert(strnlen(parm->label, CLUI_LABEL_MAX) <
+			            CLUI_LABEL_MAX);
+			clui_assert(parm->parse);
+
+			if (!strcmp(parm->label, arg))
+				/* Found it ! */
+				return p;
+		}
+	}
+
+	return -ENOENT;
+}
+
+char ** __clui_nonull(1, 3, 6)
+clui_shell_build_switch_matches(const char *                          word,
+                                size_t                                len,
+                                const struct clui_switch_parm * const parms[],
+                                unsigned int                          nr,
+                                int                                   argc,
+                                const char * const                    argv[])
+{
+	clui_assert(word);
+	clui_assert(parms);
+	clui_assert(nr);
+	clui_assert(argv);
+
+	struct clui_shell_parm_set set;
+	int                        p;
+	unsigned int               m = 0;
+	char **                    matches = NULL;
+
+	if (clui_shell_init_parm_set(&set, nr))
+		return NULL;
+
+	if (argc > 0) {
+		int a;
+
+		for (a = 0; a < argc; a ++) {
+			p = clui_shell_find_switch_parm(parms, nr, argv[a]);
+			if (p >= 0)
+				clui_shell_clear_parm(&set, p);
+		}
+	}
+
+	for (p = 0; p < (int)nr; p++) {
+		if (clui_shell_test_parm(&set, p))
+			set.samples[m++] = parms[p]->label;
+	}
+
+	if (m)
+		matches = clui_shell_build_static_matches(word,
+		                                          len,
+		                                          set.samples,
+		                                          m);
+
+	clui_shell_fini_parm_set(&set);
+
+	return matches;
+}
+
+/*
+ * History store bookkeeping. Readline allocates and releases history lines on
+ * its own, e.g. when recalled lines are edited, hence these cannot be shared
+ * nor packed. Instead, history is compacted in place once in a while so that
+ * it holds a single copy of each line and its lines occupy at most max bytes,
+ * terminating NULL bytes included. Compaction trims history down to 7/8 of
+ * max so that it does not run again upon each new line once full.
+ * bytes accounts for lines present upon last compaction plus lines added
+ * since.
+ */
+struct clui_shell_hist_store {
+	size_t       max;
+	size_t       bytes;
+	unsigned int added;
+};
+
+/* Lowest number of lines added between compactions. */
+#define CLUI_SHELL_HIST_BATCH (64U)
+
+static struct clui_shell_hist_store clui_the_hist_store = {
+	.max = CONFIG_CLUI_SHELL_HIST_SIZE
+};
+
+static unsigned int
+clui_shell_hash_hist(const char * line)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*line)
+		hash = (hash ^ (unsigned char)*line++) * 16777619U;
+
+	return hash;
+}
+
+#if defined(CONFIG_CLUI_SHELL_STATIC)
+
+/*
+ * Deduplication table of heap-free builds. Holding at most
+ * CONFIG_CLUI_SHELL_HIST_DEDUP lines, it is never more than half full.
+ */
+static int clui_the_hist_slots[4U * CONFIG_CLUI_SHELL_HIST_DEDUP];
+
+static unsigned int
+clui_shell_hist_dedup_lines(int length)
+{
+	return min((unsigned int)length,
+	           (unsigned int)CONFIG_CLUI_SHELL_HIST_DEDUP);
+}
+
+static int *
+clui_shell_alloc_hist_slots(unsigned int nr __unused)
+{
+	clui_assert(nr <= array_nr(clui_the_hist_slots));
+
+	return clui_the_hist_slots;
+}
+
+static void
+clui_shell_free_hist_slots(int * slots __unused)
+{
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
+
+static unsigned int
+clui_shell_hist_dedup_lines(int length)
+{
+	return (unsigned int)length;
+}
+
+static int *
+clui_shell_alloc_hist_slots(unsigned int nr)
+{
+	return clui_mem_alloc(CLUI_MEM_HIST_SYS, nr * sizeof(int));
+}
+
+static void
+clui_shell_free_hist_slots(int * slots)
+{
+	clui_mem_free(CLUI_MEM_HIST_SYS, slots);
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
+
+/*
+ * Walk history from the most recent entry, dropping entries duplicating a
+ * more recent one and entries past the byte limit. Kept entries are moved
+ * to the end of the list, then to its start, preserving their order.
+ * Heap-free builds only record the CONFIG_CLUI_SHELL_HIST_DEDUP most recent
+ * kept lines for duplicates lookup: duplicates of older lines are kept.
+ */
+static void
+clui_shell_compact_hist(void)
+{
+	struct clui_shell_hist_store * store = &clui_the_hist_store;
+	size_t                         limit = store->max - (store->max / 8);
+	HISTORY_STATE *                state;
+	HIST_ENTRY **                  ents;
+	int *                          slots;
+	unsigned int                   lines;
+	unsigned int                   mask = 1;
+	int                            kept;
+	int                            e;
+	bool                           full = false;
+
+	state = history_get_history_state();
+	if (!state)
+		return;
+
+	ents = state->entries;
+	if (!state->length)
+		goto free_state;
+
+	lines = clui_shell_hist_dedup_lines(state->length);
+	while (mask < (2U * lines))
+		mask <<= 1;
+
+	slots = clui_shell_alloc_hist_slots(mask);
+	if (!slots)
+		goto free_state;
+	memset(slots, 0, mask * sizeof(slots[0]));
+	mask--;
+
+	store->bytes = 0;
+	kept = state->length;
+	for (e = state->length - 1; e >= 0; e--) {
+		HIST_ENTRY * ent = ents[e];
+		size_t       len = strlen(ent->line) + 1;
+		unsigned int s;
+
+		if (!full && limit && ((store->bytes + len) > limit))
+			/* Drop this entry and all older ones. */
+			full = true;
+
+		for (s = clui_shell_hash_hist(ent->line) & mask;
+		     slots[s] && strcmp(ents[slots[s] - 1]->line, ent->line);
+		     s = (s + 1) & mask)
+			;
+
+		if (full || slots[s]) {
+			free_history_entry(ent);
+			continue;
+		}
+
+		store->bytes += len;
+		ents[--kept] = ent;
+		if (lines) {
+			slots[s] = kept + 1;
+			lines--;
+		}
+	}
+
+	if (kept) {
+		memmove(ents,
+		        &ents[kept],
+		        (state->length - kept) * sizeof(ents[0]));
+		state->length -= kept;
+		state->offset = state->length;
+		ents[state->length] = NULL;
+		history_set_history_state(state);
+	}
+
+	store->added = 0;
+
+	clui_shell_free_hist_slots(slots);
+
+free_state:
+	free(state);
+}
+
+void
+clui_shell_set_hist_size(size_t max)
+{
+	clui_the_hist_store.max = max;
+
+	clui_shell_compact_hist();
+}
+
+static void
+clui_shell_add_hist(const char * line)
+{
+	struct clui_shell_hist_store * store = &clui_the_hist_store;
+	HIST_ENTRY *                   last;
+
+	/* Don't bother compacting when repeating the last expression. */
+	last = history_get(history_base + history_length - 1);
+	if (last && !strcmp(last->line, line))
+		return;
+
+	add_history(line);
+
+	store->bytes += strlen(line) + 1;
+	store->added++;
+
+	if ((store->max && (store->bytes > store->max)) ||
+	    (store->added >= max(CLUI_SHELL_HIST_BATCH,
+	                         (unsigned int)history_length / 8)))
+		clui_shell_compact_hist();
+}
+
+#if defined(CONFIG_CLUI_SHELL_LAZY_HIST)
+
+/*
+ * History file is loaded by a background thread so that the first prompt
+ * shows up without delay whatever the history size. Loaded entries are
+ * installed in front of entries recorded in the meantime, once readline is
+ * idle, see clui_shell_sync_hist().
+ */
+struct clui_shell_hist_loader {
+	pthread_t             thread;
+	bool                  busy;
+	volatile sig_atomic_t ready;
+	HIST_ENTRY **         entries;
+	int                   nr;
+};
+
+static struct clui_shell_hist_loader clui_the_hist_loader;
+
+static HIST_ENTRY *
+clui_shell_alloc_hist_entry(const char * line, size_t len)
+{
+	HIST_ENTRY * ent;
+
+	/* Allocate the way readline does so that it may release entries. */
+	ent = clui_mem_alloc(CLUI_MEM_HIST_SYS, sizeof(*ent));
+	if (!ent)
+		return NULL;
+
+	ent->line = clui_mem_strndup(CLUI_MEM_HIST_SYS, line, len);
+	if (!ent->line) {
+		clui_mem_free(CLUI_MEM_HIST_SYS, ent);
+		return NULL;
+	}
+
+	ent->timestamp = NULL;
+	ent->data = NULL;
+
+	return ent;
+}
+
+static int
+clui_shell_parse_hist(const char * map, size_t size)
+{
+	const char *  ptr = map;
+	const char *  end = map + size;
+	HIST_ENTRY ** ents = NULL;
+	int           nr = 0;
+	int           max = 0;
+
+	while (ptr < end) {
+		const char * eol;
+		size_t       len;
+
+		eol = memchr(ptr, '\n', end - ptr);
+		len = eol ? (size_t)(eol - ptr) : (size_t)(end - ptr);
+
+		if (len) {
+			HIST_ENTRY * ent;
+
+			if ((nr + 1) >= max) {
+				HIST_ENTRY ** tmp;
+
+				max = max ? (2 * max) : 256;
+				tmp = clui_mem_realloc(CLUI_MEM_HIST_SYS,
+				                       ents,
+				                       max * sizeof(ents[0]));
+				if (!tmp)
+					break;
+
+				ents = tmp;
+			}
+
+			ent = clui_shell_alloc_hist_entry(ptr, len);
+			if (!ent)
+				break;
+
+			ents[nr++] = ent;
+		}
+
+		ptr += len + 1;
+	}
+
+	clui_the_hist_loader.entries = ents;
+	clui_the_hist_loader.nr = nr;
+
+	return nr;
+}
+
+static void *
+clui_shell_load_hist(void * arg)
+{
+	const char * path = arg;
+	int          fd;
+	struct stat  st;
+	void *       map;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		goto ready;
+
+	if (fstat(fd, &st) || !st.st_size)
+		goto close;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		goto close;
+
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	clui_shell_parse_hist(map, st.st_size);
+
+	munmap(map, st.st_size);
+
+close:
+	close(fd);
+
+ready:
+	__atomic_store_n(&clui_the_hist_loader.ready, 1, __ATOMIC_RELEASE);
+
+	/* Have history installed as soon as possible. */
+	clui_shell_notify();
+
+	return NULL;
+}
+
+static void
+clui_shell_start_hist_load(const char * path)
+{
+	clui_assert(!clui_the_hist_loader.busy);
+
+	clui_the_hist_loader.ready = 0;
+	clui_the_hist_loader.entries = NULL;
+	clui_the_hist_loader.nr = 0;
+
+	if (pthread_create(&clui_the_hist_loader.thread,
+	                   NULL,
+	                   clui_shell_load_hist,
+	                   (void *)path)) {
+		/* Fallback to synchronous loading. */
+		read_history(path);
+		clui_shell_compact_hist();
+		return;
+	}
+
+	clui_the_hist_loader.busy = true;
+}
+
+static void
+clui_shell_free_hist(HIST_ENTRY ** ents, int nr)
+{
+	while (nr--) {
+		clui_mem_free(CLUI_MEM_HIST_SYS, ents[nr]->line);
+		clui_mem_free(CLUI_MEM_HIST_SYS, ents[nr]);
+	}
+	clui_mem_free(CLUI_MEM_HIST_SYS, ents);
+}
+
+static void
+clui_shell_install_hist(HIST_ENTRY ** ents, int nr)
+{
+	HISTORY_STATE * state;
+	HIST_ENTRY **   cur;
+	int             e;
+
+	state = history_get_history_state();
+	if (!state) {
+		clui_shell_free_hist(ents, nr);
+		return;
+	}
+
+	cur = state->entries;
+	if (state->length) {
+		HIST_ENTRY ** tmp;
+
+		/* Append entries recorded since startup. */
+		tmp = clui_mem_realloc(CLUI_MEM_HIST_SYS,
+		                       ents,
+		                       (nr + state->length + 1) * sizeof(ents[0]));
+		if (!tmp) {
+			clui_shell_free_hist(ents, nr);
+			free(state);
+			return;
+		}
+
+		ents = tmp;
+		memcpy(&ents[nr], cur, state->length * sizeof(ents[0]));
+		nr += state->length;
+	}
+
+	/* History is owned by readline from now on. */
+	for (e = 0; e < (nr - state->length); e++) {
+		clui_mem_disown(CLUI_MEM_HIST_SYS, ents[e]->line);
+		clui_mem_disown(CLUI_MEM_HIST_SYS, ents[e]);
+	}
+	clui_mem_disown(CLUI_MEM_HIST_SYS, ents);
+
+	ents[nr] = NULL;
+
+	state->entries = ents;
+	state->offset = nr;
+	state->length = nr;
+	state->size = nr + 1;
+	history_set_history_state(state);
+
+	free(cur);
+	free(state);
+
+	if (history_is_stifled())
+		stifle_history(history_max_entries);
+
+	clui_shell_compact_hist();
+}
+
+static void
+clui_shell_sync_hist(bool wait)
+{
+	if (!clui_the_hist_loader.busy)
+		return;
 
-	struct fbmp   bmp;
-	int           p = -ENOENT;
-	char **       matches = NULL;
+	if (!wait &&
+	    !__atomic_load_n(&clui_the_hist_loader.ready, __ATOMIC_ACQUIRE))
+		return;
 
-	if (fbmp_init_set(&bmp, nr))
-		return NULL;
+	pthread_join(clui_the_hist_loader.thread, NULL);
+	clui_the_hist_loader.busy = false;
 
-	if (argc > 0) {
-		int a;
+	if (clui_the_hist_loader.nr)
+		clui_shell_install_hist(clui_the_hist_loader.entries,
+		                        clui_the_hist_loader.nr);
+	else
+		clui_mem_free(CLUI_MEM_HIST_SYS, clui_the_hist_loader.entries);
+}
 
-		for (a = 0; a < (argc - 1); a += 2) {
-			p = clui_shell_find_kword_parm(parms, nr, argv[a]);
-			if (p >= 0)
-				fbmp_clear(&bmp, p);
-		}
+#else  /* !defined(CONFIG_CLUI_SHELL_LAZY_HIST) */
 
-		p = clui_shell_find_kword_parm(parms, nr, argv[argc - 1]);
-	}
+static void
+clui_shell_start_hist_load(const char * path)
+{
+	read_history(path);
+	clui_shell_compact_hist();
+}
 
-	clui_assert(p < (int)nr);
+static void
+clui_shell_sync_hist(bool wait __unused)
+{
+}
 
-	if (!(argc % 2)) {
-		const char **    samples;
-		struct fbmp_iter iter;
-		unsigned int     m = 0;
+#endif /* defined(CONFIG_CLUI_SHELL_LAZY_HIST) */
 
-		samples = malloc(nr * sizeof(samples[0]));
-		if (!samples)
-			goto fini;
+#if defined(CONFIG_CLUI_PLUGIN)
 
-		if (p >= 0)
-			fbmp_clear(&bmp, p);
+char ** __clui_nonull(1, 2)
+clui_shell_build_plugin_matches(const struct clui_plugin_cmd * plug,
+                                const char *                   word,
+                                size_t                         len,
+                                int                            argc,
+                                const char * const             argv[],
+                                void *                         data)
+{
+	clui_assert_plugin_cmd(plug);
+	clui_assert(word);
 
-		fbmp_foreach_bit(&iter, &bmp, p) {
-			clui_assert(parms[p]);
-			clui_assert(parms[p]->clui);
-			clui_assert(parms[p]->clui->label);
+	if (!argc && plug->hints_nr)
+		/*
+		 * Complete first argument using stub hints to prevent from
+		 * loading plugin until really required.
+		 */
+		return clui_shell_build_static_matches(word,
+		                                       len,
+		                                       plug->hints,
+		                                       plug->hints_nr);
 
-			samples[m++] = parms[p]->clui->label;
-		}
+	return clui_plugin_complete(plug, word, len, argc, argv, data);
+}
 
-		if (m)
-			matches = clui_shell_build_static_matches(word,
-			                                          len,
-			                                          samples,
-			                                          m);
+#endif /* defined(CONFIG_CLUI_PLUGIN) */
 
-		free(samples);
-	}
-	else if ((p >= 0) && fbmp_test(&bmp, p)) {
-		clui_assert(parms[p]);
-		clui_assert(parms[p]->clui);
-		clui_assert(parms[p]->clui->label);
+#if defined(CONFIG_CLUI_SHELL_STATIC)
 
-		if (parms[p]->build)
-			matches = parms[p]->build(word, len, data);
-		else
-			matches = NULL;
-	}
+/*
+ * Storage of the expression currently returned by clui_shell_read_expr() and
+ * of the words of the line being completed.
+ */
+static char   clui_shell_expr_line[LINE_MAX];
+static char * clui_shell_expr_words[CONFIG_CLUI_SHELL_WORD_MAX];
+static char * clui_shell_cmpl_words[CONFIG_CLUI_SHELL_WORD_MAX];
 
-fini:
-	fbmp_fini(&bmp);
+#define CLUI_SHELL_EXPR_WORDS clui_shell_expr_words
+#define CLUI_SHELL_CMPL_WORDS clui_shell_cmpl_words
 
-	return matches;
+static char **
+clui_shell_alloc_words(char ** storage, unsigned int * nr)
+{
+	*nr = CONFIG_CLUI_SHELL_WORD_MAX;
+
+	return storage;
 }
 
-static int __clui_nonull(1, 3) __nothrow __clui_pure
-clui_shell_find_switch_parm(
-	const struct clui_switch_parm * const restrict parms[],
-	unsigned int                                   nr,
-	const char *                                   arg)
+static int
+clui_shell_grow_words(char *** toks __unused, unsigned int * nr __unused)
 {
-	clui_assert(parms);
-	clui_assert(nr);
-	clui_assert(arg);
+	return -E2BIG;
+}
 
-	if (*arg) {
-		unsigned int p;
+static void
+clui_shell_free_words(char ** toks __unused)
+{
+}
 
-		for (p = 0; p < nr; p++) {
-			const struct clui_switch_parm * parm = parms[p];
+/* Move line returned by readline() into our own storage. */
+static char *
+clui_shell_hold_line(char * ln)
+{
+	size_t len;
 
-			clui_assert(parm);
-			clui_assert(parm->label);
-			clui_assert(strnlen(parm->label, CLUI_LABEL_MAX) <
-			            CLUI_LABEL_MAX);
-			clui_assert(parm->parse);
+	len = strnlen(ln, sizeof(clui_shell_expr_line));
+	if (len < sizeof(clui_shell_expr_line))
+		memcpy(clui_shell_expr_line, ln, len + 1);
 
-			if (!strcmp(parm->label, arg))
-				/* Found it ! */
-				return p;
-		}
-	}
+	free(ln);
 
-	return -ENOENT;
+	return (len < sizeof(clui_shell_expr_line)) ? clui_shell_expr_line :
+	                                              NULL;
 }
 
-char ** __clui_nonull(1, 3, 6)
-clui_shell_build_switch_matches(const char *                          word,
-                                size_t                                len,
-                                const struct clui_switch_parm * const parms[],
-                                unsigned int                          nr,
-                                int                                   argc,
-                                const char * const                    argv[])
+static void
+clui_shell_release_line(char * ln __unused)
 {
-	clui_assert(word);
-	clui_assert(parms);
-	clui_assert(nr);
-	clui_assert(argv);
+}
 
-	struct fbmp      bmp;
-	const char **    samples;
-	int              p = -ENOENT;
-	struct fbmp_iter iter;
-	unsigned int     m = 0;
-	char **          matches = NULL;
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
 
-	if (fbmp_init_set(&bmp, nr))
-		return NULL;
+#define CLUI_SHELL_EXPR_WORDS NULL
+#define CLUI_SHELL_CMPL_WORDS NULL
 
-	samples = malloc(nr * sizeof(samples[0]));
-	if (!samples)
-		goto fini;
+static char **
+clui_shell_alloc_words(char ** storage __unused, unsigned int * nr)
+{
+	*nr = 8;
 
-	if (argc > 0) {
-		int a;
+	return clui_mem_alloc(CLUI_MEM_EXPR_SYS, *nr * sizeof(storage[0]));
+}
 
-		for (a = 0; a < argc; a ++) {
-			p = clui_shell_find_switch_parm(parms, nr, argv[a]);
-			if (p >= 0)
-				fbmp_clear(&bmp, p);
-		}
-	}
+static int
+clui_shell_grow_words(char *** toks, unsigned int * nr)
+{
+	char ** tmp;
 
-	fbmp_foreach_bit(&iter, &bmp, p)
-		samples[m++] = parms[p]->label;
+	tmp = clui_mem_realloc(CLUI_MEM_EXPR_SYS,
+	                       *toks,
+	                       2 * *nr * sizeof(tmp[0]));
+	if (!tmp)
+		return -errno;
 
-	if (m)
-		matches = clui_shell_build_static_matches(word,
-		                                          len,
-		                                          samples,
-		                                          m);
+	*toks = tmp;
+	*nr *= 2;
 
-	free(samples);
+	return 0;
+}
 
-fini:
-	fbmp_fini(&bmp);
+static void
+clui_shell_free_words(char ** toks)
+{
+	clui_mem_free(CLUI_MEM_EXPR_SYS, toks);
+}
 
-	return matches;
+static char *
+clui_shell_hold_line(char * ln)
+{
+	return ln;
 }
 
+static void
+clui_shell_release_line(char * ln)
+{
+	free(ln);
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
+
 static int
 clui_shell_read_line(char ** line)
 {
@@ -283,6 +1774,15 @@ clui_shell_read_line(char ** line)
 	/* Reset redisplay event handling logic. */
 	clui_the_shell.redisplay = 0;
 
+	/*
+	 * Write out messages and tell user about background jobs completed
+	 * since last prompt.
+	 */
+	clui_shell_write_prints();
+
+	/* Install history loaded in the background if available. */
+	clui_shell_sync_hist(false);
+
 	ln = readline(clui_the_shell.prompt);
 	if (!ln) {
 		/* End of stream required using ^D. */
@@ -311,28 +1811,33 @@ clui_shell_read_line(char ** line)
 		return -ENODATA;
 	}
 
-	*line = ln;
+	*line = clui_shell_hold_line(ln);
+	if (!*line)
+		return -E2BIG;
 
 	return 0;
 }
 
-static void
-clui_shell_hist_expr(const struct clui_shell_expr * expr, size_t max_size)
+static size_t
+clui_shell_expr_size(const struct clui_shell_expr * expr)
 {
-	clui_assert(expr);
-	clui_assert(expr->nr);
-	clui_assert(expr->words);
-	clui_assert(expr->ln);
-	clui_assert(max_size > 1);
+	unsigned int w;
+	size_t       size = strlen(expr->words[0]) + 1;
+
+	for (w = 1; w < expr->nr; w++)
+		size += strlen(expr->words[w]) + 1;
+
+	return size;
+}
 
+static char *
+clui_shell_format_expr(const struct clui_shell_expr * expr,
+                       char *                         ln,
+                       size_t                         max_size __unused)
+{
 	unsigned int   w;
-	char         * ln;
 	char         * ptr;
 
-	ln = malloc(max_size);
-	if (!ln)
-		return;
-
 	ptr = stpcpy(ln, expr->words[0]);
 	clui_assert((size_t)(ptr - ln) < max_size);
 
@@ -344,13 +1849,72 @@ clui_shell_hist_expr(const struct clui_shell_expr * expr, size_t max_size)
 		clui_assert((size_t)(ptr - ln) < max_size);
 	}
 
-	add_history(ln);
+	return ln;
+}
 
-	free(ln);
+char * __clui_nonull(1)
+clui_shell_join_expr(const struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+	clui_assert(expr->nr);
+	clui_assert(expr->words);
+	clui_assert(expr->ln);
+
+	size_t max_size = clui_shell_expr_size(expr);
+	char * ln;
+
+	ln = clui_mem_alloc(CLUI_MEM_EXPR_SYS, max_size);
+	if (!ln)
+		return NULL;
+
+	return clui_shell_format_expr(expr, ln, max_size);
+}
+
+/*
+ * Words are carved out of a line shorter than LINE_MAX and are separated by
+ * at least one character. Hence joining them with single spaces always fits
+ * into a LINE_MAX sized buffer.
+ */
+static char *
+clui_shell_print_expr(const struct clui_shell_expr * expr, char ln[LINE_MAX])
+{
+	clui_assert(clui_shell_expr_size(expr) <= LINE_MAX);
+
+	return clui_shell_format_expr(expr, ln, LINE_MAX);
+}
+
+#if defined(CONFIG_CLUI_SHELL_RECORD)
+
+static void
+clui_shell_record_expr(const struct clui_shell_expr * expr)
+{
+	char ln[LINE_MAX];
+
+	clui_shell_print_expr(expr, ln);
+
+	clui_shell_record(CLUI_RECORD_EXPR_TYPE, ln, strlen(ln));
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_RECORD) */
+
+static void
+clui_shell_record_expr(const struct clui_shell_expr * expr __unused)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_RECORD) */
+
+static void
+clui_shell_hist_expr(const struct clui_shell_expr * expr)
+{
+	char ln[LINE_MAX];
+
+	clui_shell_add_hist(clui_shell_print_expr(expr, ln));
 }
 
 static int
 clui_shell_break_expr(char *** restrict words,
+                      char ** restrict  storage,
                       char * restrict   line,
                       size_t            len)
 {
@@ -364,8 +1928,7 @@ clui_shell_break_expr(char *** restrict words,
 	unsigned int cnt;
 	int          ret;
 
-	nr = 8;
-	toks = malloc(nr * sizeof(toks[0]));
+	toks = clui_shell_alloc_words(storage, &nr);
 	if (!toks)
 		return -errno;
 
@@ -387,16 +1950,9 @@ clui_shell_break_expr(char *** restrict words,
 
 		clui_assert(cnt <= nr);
 		if (cnt == nr) {
-			char **tmp;
-
-			nr *= 2;
-			tmp = realloc(toks, (nr * sizeof(toks[0])));
-			if (!tmp) {
-				ret = -errno;
+			ret = clui_shell_grow_words(&toks, &nr);
+			if (ret)
 				goto free;
-			}
-
-			toks = tmp;
 		}
 
 		toks[cnt++] = &line[pos];
@@ -414,81 +1970,228 @@ clui_shell_break_expr(char *** restrict words,
 	return cnt;
 
 free:
-	free(toks);
+	clui_shell_free_words(toks);
+
+	return ret;
+}
+
+int __clui_nonull(1, 2)
+clui_shell_parse_expr(struct clui_shell_expr * expr, char * ln)
+{
+	clui_assert(expr);
+	clui_assert(ln);
+
+	int len;
+	int ret;
+
+	len = ustr_parse(ln, LINE_MAX - 1);
+	clui_assert(len);
+	if (len < 0)
+		return len;
+
+	ret = clui_shell_break_expr(&expr->words,
+	                            CLUI_SHELL_EXPR_WORDS,
+	                            ln,
+	                            len);
+	if (ret <= 0)
+		return !ret ? -ENODATA : ret;
+
+	expr->nr = ret;
+	expr->ln = ln;
+
+	return 0;
+}
+
+void __clui_nonull(1)
+clui_shell_commit_expr(const struct clui_shell_expr * expr)
+{
+	if (clui_the_shell.hist)
+		clui_shell_hist_expr(expr);
+
+	clui_shell_record_expr(expr);
+}
+
+int __clui_nonull(1)
+clui_shell_read_expr(struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+
+	char * ln;
+	int    ret;
+
+	if (clui_the_shell.shutdown) {
+		/* Discard pasted expressions not run yet. */
+		clui_shell_drop_paste();
+		return -ESHUTDOWN;
+	}
+
+	ret = clui_shell_pop_paste(expr);
+	if (ret != -ENOENT) {
+		if (!ret) {
+			char buff[LINE_MAX];
+
+			/* Echo pasted expression as if it was typed in. */
+			fprintf(rl_outstream,
+			        "%s%s\n",
+			        clui_the_shell.prompt ? clui_the_shell.prompt : "",
+			        clui_shell_print_expr(expr, buff));
+		}
+
+		return ret;
+	}
+
+	ret = clui_shell_read_line(&ln);
+	if (ret)
+		return ret;
+
+	ret = clui_shell_parse_expr(expr, ln);
+	if (ret) {
+		clui_shell_release_line(ln);
+		return ret;
+	}
+
+	clui_shell_commit_expr(expr);
+
+	/* Now record expressions pasted past this one in a single batch. */
+	clui_shell_commit_paste();
+
+	return 0;
+}
+
+void __nothrow __leaf
+clui_shell_free_expr(const struct clui_shell_expr * expr)
+{
+	clui_assert(expr);
+	clui_assert(expr->nr);
+	clui_assert(expr->words);
+	clui_assert(expr->ln);
+
+	clui_shell_free_words(expr->words);
+	clui_shell_release_line(expr->ln);
+}
+
+struct clui_shell_builtin {
+	const char * label;
+	int       (* run)(const struct clui_shell_expr * expr);
+};
+
+static const struct clui_shell_builtin clui_shell_builtins[] = {
+#if defined(CONFIG_CLUI_SHELL_JOBS)
+	{ .label = "jobs", .run = clui_shell_jobs_builtin },
+	{ .label = "wait", .run = clui_shell_wait_builtin },
+	{ .label = "kill", .run = clui_shell_kill_builtin },
+#endif /* defined(CONFIG_CLUI_SHELL_JOBS) */
+	{ .label = NULL,   .run = NULL }
+};
+
+static const struct clui_shell_builtin *
+clui_shell_find_builtin(const char * label)
+{
+	const struct clui_shell_builtin * bltin;
+
+	for (bltin = clui_shell_builtins; bltin->label; bltin++) {
+		if (!strcmp(bltin->label, label))
+			return bltin;
+	}
 
-	return ret;
+	return NULL;
 }
 
 int __clui_nonull(1)
-clui_shell_read_expr(struct clui_shell_expr * expr)
+clui_shell_run_builtin(const struct clui_shell_expr * expr)
 {
 	clui_assert(expr);
+	clui_assert(expr->nr);
+	clui_assert(expr->words);
 
-	char * ln;
-	int    ret;
-	int    len;
-
-	ret = clui_shell_read_line(&ln);
-	if ((ret == -ESHUTDOWN) || (ret == -ENODATA))
-		return ret;
-
-	len = ustr_parse(ln, LINE_MAX - 1);
-	clui_assert(len);
-	if (len < 0) {
-		ret = len;
-		goto free;
-	}
-
-	ret = clui_shell_break_expr(&expr->words, ln, len);
-	if (ret <= 0) {
-		ret = !ret ? -ENODATA : ret;
-		goto free;
-	}
-
-	expr->nr = ret;
-	expr->ln = ln;
+	const struct clui_shell_builtin * bltin;
 
-	if (clui_the_shell.hist)
-		clui_shell_hist_expr(expr, len + 1);
+	bltin = clui_shell_find_builtin(expr->words[0]);
+	if (!bltin)
+		return -ENOENT;
 
-	return 0;
+	return bltin->run(expr);
+}
 
-free:
-	free(ln);
+/* Run expr as clui_shell_exec_expr() does, minus the timing prefix. */
+int __clui_nonull(1, 4, 5)
+clui_shell_run_expr(struct clui_parser *           parser,
+                    const struct clui_opt_set *    set,
+                    const struct clui_cmd *        cmd,
+                    const struct clui_exec_ops *   ops,
+                    const struct clui_shell_expr * expr,
+                    void *                         data)
+{
+	clui_assert(expr);
+	clui_assert(expr->nr);
+	clui_assert(expr->words);
 
-	return ret;
+	const struct clui_shell_builtin * bltin;
+	char *                            argv[expr->nr + 2];
+
+	bltin = clui_shell_find_builtin(expr->words[0]);
+	if (bltin)
+		return bltin->run(expr);
+
+	/* Give the program name in front of words, as a command line would. */
+	argv[0] = parser->argv0;
+	memcpy(&argv[1], expr->words, expr->nr * sizeof(argv[0]));
+	argv[expr->nr + 1] = NULL;
+
+	return clui_run(parser,
+	                set,
+	                cmd,
+	                ops,
+	                (int)expr->nr + 1,
+	                argv,
+	                data);
 }
 
-void __nothrow __leaf
-clui_shell_free_expr(const struct clui_shell_expr * expr)
+int __clui_nonull(1, 4, 5)
+clui_shell_exec_expr(struct clui_parser *           parser,
+                     const struct clui_opt_set *    set,
+                     const struct clui_cmd *        cmd,
+                     const struct clui_exec_ops *   ops,
+                     const struct clui_shell_expr * expr,
+                     void *                         data)
 {
 	clui_assert(expr);
 	clui_assert(expr->nr);
 	clui_assert(expr->words);
-	clui_assert(expr->ln);
 
-	free(expr->words);
-	free(expr->ln);
+	if (clui_shell_timed_word(expr->words[0]))
+		return clui_shell_time_expr(parser, set, cmd, ops, expr, data);
+
+	return clui_shell_run_expr(parser, set, cmd, ops, expr, data);
 }
 
 void __nothrow __leaf
 clui_shell_shutdown(void)
 {
 	clui_the_shell.shutdown = 1;
+	clui_shell_notify();
 }
 
 void __nothrow __leaf
 clui_shell_redisplay(void)
 {
 	clui_the_shell.redisplay = 1;
+	clui_shell_notify();
 }
 
 static int
 clui_shell_handle_readline_events(void)
 {
+	clui_shell_sync_hist(false);
+
+	if (!clui_shell_print_delay())
+		clui_shell_redraw_prints();
+
 	if (clui_the_shell.redisplay) {
 		/* Move cursor to next line. */
 		rl_crlf();
+		/* Print completion notices of background jobs if any. */
+		clui_shell_report_jobs();
 		/* Tell readline we have moved onto a new empty line. */
 		rl_on_new_line();
 		/* Wipe buffered line content out. */
@@ -537,12 +2240,186 @@ clui_shell_handle_readline_events(void)
 	return 0;
 }
 
+#if defined(CONFIG_CLUI_SHELL_BULK_PASTE)
+
+/*
+ * Terminal input buffer used while ingesting pasted text to prevent from
+ * issuing one read(2) syscall per input character, see clui_shell_getc().
+ */
+struct clui_shell_input {
+	bool   bulk;
+	size_t pos;
+	size_t len;
+	char   buff[4096];
+};
+
+static struct clui_shell_input clui_the_input;
+
+static int
+clui_shell_input_available(void)
+{
+	return 1;
+}
+
+void
+clui_shell_bulk_input(bool on)
+{
+	clui_the_input.bulk = on;
+}
+
+static bool
+clui_shell_input_buffered(void)
+{
+	return clui_the_input.pos < clui_the_input.len;
+}
+
+static int
+clui_shell_pop_input(void)
+{
+	struct clui_shell_input * in = &clui_the_input;
+
+	clui_assert(in->pos < in->len);
+
+	if ((in->pos + 1) == in->len)
+		rl_input_available_hook = NULL;
+
+	return (unsigned char)in->buff[in->pos++];
+}
+
+static int
+clui_shell_read_input(FILE * stream)
+{
+	struct clui_shell_input * in = &clui_the_input;
+	ssize_t                   ret;
+
+	if (!in->bulk)
+		return rl_getc(stream);
+
+	ret = read(fileno(stream), in->buff, sizeof(in->buff));
+	if (ret <= 0)
+		/* Let readline deal with end of input and errors. */
+		return rl_getc(stream);
+
+	in->pos = 0;
+	in->len = ret;
+
+	/*
+	 * Tell readline that more input is pending since it would otherwise
+	 * only check the terminal file descriptor.
+	 */
+	rl_input_available_hook = clui_shell_input_available;
+
+	return clui_shell_pop_input();
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_BULK_PASTE) */
+
+static bool
+clui_shell_input_buffered(void)
+{
+	return false;
+}
+
+static int
+clui_shell_pop_input(void)
+{
+	clui_assert(0);
+
+	return EOF;
+}
+
+static int
+clui_shell_read_input(FILE * stream)
+{
+	return rl_getc(stream);
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_BULK_PASTE) */
+
+/*
+ * Input character fetcher multiplexing terminal input with events notified
+ * through clui_the_shell.evfd so that an idle shell sleeps until either
+ * happens instead of periodically polling for events thanks to rl_event_hook.
+ */
+static int
+clui_shell_getc(FILE * stream)
+{
+	struct pollfd fds[] = {
+		{ .fd = fileno(stream),      .events = POLLIN },
+		{ .fd = clui_the_shell.evfd, .events = POLLIN }
+	};
+
+	if (clui_shell_input_buffered())
+		return clui_shell_pop_input();
+
+	while (true) {
+		int ret;
+
+		/* Wake up when next batch of messages is due, if any. */
+		ret = poll(fds, array_nr(fds), clui_shell_print_delay());
+		if (ret < 0) {
+			if (errno != EINTR)
+				return rl_getc(stream);
+
+			/* Let readline run its own signal handling logic. */
+			rl_check_signals();
+			continue;
+		}
+
+		if (!ret) {
+			clui_shell_handle_readline_events();
+			if (rl_done)
+				return '\n';
+			continue;
+		}
+
+		if (fds[1].revents) {
+			uint64_t val;
+			ssize_t  ret __unused;
+
+			/* Acknowledge notifications. */
+			ret = read(clui_the_shell.evfd, &val, sizeof(val));
+			clui_assert((ret == sizeof(val)) || (errno == EAGAIN));
+
+			clui_shell_handle_readline_events();
+			if (rl_done)
+				/* Make readline() return as soon as possible. */
+				return '\n';
+		}
+
+		if (fds[0].revents)
+			return clui_shell_read_input(stream);
+	}
+}
+
+static void
+clui_shell_init_events(void)
+{
+	clui_the_shell.evfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (clui_the_shell.evfd >= 0)
+		/* Recording may have been started before shell initialization. */
+		clui_shell_install_getc(clui_shell_getc);
+	else
+		/* Fall back to periodic polling. */
+		rl_event_hook = clui_shell_handle_readline_events;
+}
+
+static void
+clui_shell_fini_events(void)
+{
+	if (clui_the_shell.evfd >= 0) {
+		clui_shell_install_getc(rl_getc);
+		close(clui_the_shell.evfd);
+		clui_the_shell.evfd = -1;
+	}
+	else
+		rl_event_hook = NULL;
+}
+
 static char *
-clui_shell_hist_path(const char * name)
+clui_shell_hist_path(const char * name, char path[PATH_MAX])
 {
 	const char *base_dir;
-	char       *conf_dir;
-	char       *hist_path;
 	int         err;
 
 	err = upath_validate_file_name(name);
@@ -557,34 +2434,277 @@ clui_shell_hist_path(const char * name)
 		if (!base_dir)
 			return NULL;
 
-		err = asprintf(&conf_dir, "%s/.config/%s", base_dir, name);
+		err = snprintf(path, PATH_MAX, "%s/.config/%s", base_dir, name);
 	}
 	else
-		err = asprintf(&conf_dir, "%s/%s", base_dir, name);
+		err = snprintf(path, PATH_MAX, "%s/%s", base_dir, name);
 
-	if (err < 0)
+	/* Keep room for the trailing "/history" component. */
+	if ((err < 0) || ((size_t)err >= (PATH_MAX - sizeof("/history")))) {
+		errno = ENAMETOOLONG;
 		return NULL;
+	}
 
-	if (mkdir(conf_dir, S_IRUSR | S_IWUSR)) {
+	if (mkdir(path, S_IRUSR | S_IWUSR)) {
 		clui_assert(errno != EFAULT);
 		if (errno != EEXIST)
-			goto free;
+			return NULL;
 	}
 
-	err = asprintf(&hist_path, "%s/history", conf_dir);
-	if (err < 0)
-		goto free;
+	strcpy(&path[err], "/history");
 
-	free(conf_dir);
+	return path;
+}
 
-	return hist_path;
+/*
+ * Candidates listing is rendered into a fixed size buffer flushed using
+ * write(2) once full or completed.
+ */
+struct clui_shell_render {
+	int    fd;
+	size_t len;
+	char   buff[4096];
+};
 
-free:
-	err = errno;
-	free(conf_dir);
+static void
+clui_shell_flush_render(struct clui_shell_render * render)
+{
+	size_t off = 0;
 
-	errno = err;
-	return NULL;
+	while (off < render->len) {
+		ssize_t ret;
+
+		ret = write(render->fd, &render->buff[off], render->len - off);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		off += ret;
+	}
+
+	render->len = 0;
+}
+
+static void
+clui_shell_render(struct clui_shell_render * render,
+                  const char *               data,
+                  size_t                     len)
+{
+	while (len) {
+		size_t sz = min(len, sizeof(render->buff) - render->len);
+
+		memcpy(&render->buff[render->len], data, sz);
+		render->len += sz;
+		data += sz;
+		len -= sz;
+
+		if (render->len == sizeof(render->buff))
+			clui_shell_flush_render(render);
+	}
+}
+
+static void
+clui_shell_render_pad(struct clui_shell_render * render, size_t len)
+{
+	while (len) {
+		size_t sz = min(len, sizeof(render->buff) - render->len);
+
+		memset(&render->buff[render->len], ' ', sz);
+		render->len += sz;
+		len -= sz;
+
+		if (render->len == sizeof(render->buff))
+			clui_shell_flush_render(render);
+	}
+}
+
+static size_t
+clui_shell_match_len(char * const * matches, unsigned int index)
+{
+	const struct clui_shell_match_cache * cache = &clui_shell_the_cache;
+
+	/* Use length computed at generation time if available. */
+	if (cache->matches == matches)
+		return cache->cands[index].len;
+
+	return strlen(matches[index + 1]);
+}
+
+/*
+ * Part of a match readline measures when computing the width of listing
+ * columns, i.e. the last path component of file names, trailing slash of
+ * directories included.
+ */
+static const char *
+clui_shell_match_printable(const char * match, size_t * len)
+{
+	const char * end = &match[*len];
+	const char * base = end;
+
+	if (!rl_filename_completion_desired)
+		return match;
+
+	if ((base > match) && (base[-1] == '/'))
+		base--;
+	while ((base > match) && (base[-1] != '/'))
+		base--;
+
+	*len = (size_t)(end - base);
+
+	return base;
+}
+
+/*
+ * Number of terminal columns a match occupies, counted the same way
+ * readline does: invalid multibyte sequences take one column per byte.
+ */
+static size_t
+clui_shell_match_cols(const char * str, size_t len)
+{
+	mbstate_t state;
+	size_t    cols = 0;
+
+	memset(&state, 0, sizeof(state));
+
+	while (len) {
+		wchar_t wc;
+		size_t  sz;
+		int     width;
+
+		if (!((unsigned char)*str & 0x80)) {
+			/* Fast path for ASCII characters. */
+			cols++;
+			str++;
+			len--;
+			continue;
+		}
+
+		sz = mbrtowc(&wc, str, len, &state);
+		if ((sz == (size_t)-1) || (sz == (size_t)-2)) {
+			memset(&state, 0, sizeof(state));
+			sz = 1;
+			width = 1;
+		}
+		else {
+			if (!sz)
+				sz = 1;
+			width = wcwidth(wc);
+			if (width < 0)
+				width = 1;
+		}
+
+		cols += (size_t)width;
+		str += sz;
+		len -= sz;
+	}
+
+	return cols;
+}
+
+/*
+ * Display completion candidates in columns, sorted down columns as readline
+ * does. Unless the page-completions readline variable is off, listing is
+ * truncated to what fits onto the screen so that display time does not grow
+ * with the number of candidates.
+ */
+static void
+clui_shell_display_matches(char ** matches, int nr, int max)
+{
+	struct clui_shell_render render;
+	int                      lines;
+	int                      cols;
+	size_t                   width;
+	unsigned int             col_nr;
+	unsigned int             row_nr;
+	unsigned int             cnt = nr;
+	unsigned int             r;
+	const char *             page;
+
+	if (clui_shell_the_cache.matches &&
+	    ((clui_shell_the_cache.matches != matches) ||
+	     (clui_shell_the_cache.nr != (unsigned int)nr)))
+		/* Readline altered the array: cached lengths are unusable. */
+		clui_shell_the_cache.matches = NULL;
+
+	if (max <= 0) {
+		for (r = 0; r < cnt; r++) {
+			size_t       len = clui_shell_match_len(matches, r);
+			const char * str;
+
+			str = clui_shell_match_printable(matches[r + 1], &len);
+			max = max((size_t)max, clui_shell_match_cols(str, len));
+		}
+	}
+
+	rl_get_screen_size(&lines, &cols);
+	if (cols <= 0)
+		cols = 80;
+
+	/* Separate columns with 2 spaces. */
+	width = max + 2;
+	col_nr = max((unsigned int)cols / width, 1U);
+	row_nr = (cnt + col_nr - 1) / col_nr;
+
+	page = rl_variable_value("page-completions");
+	if ((!page || strcmp(page, "off")) &&
+	    (lines > 2) &&
+	    (row_nr > (unsigned int)(lines - 2))) {
+		/* Keep room for the trailer and prompt lines. */
+		row_nr = lines - 2;
+		cnt = row_nr * col_nr;
+	}
+
+	fflush(rl_outstream);
+
+	render.fd = fileno(rl_outstream);
+	render.len = 0;
+
+	clui_shell_render(&render, "\n", 1);
+
+	for (r = 0; r < row_nr; r++) {
+		unsigned int m;
+
+		for (m = r; m < cnt; m += row_nr) {
+			size_t       len = clui_shell_match_len(matches, m);
+			const char * str;
+			size_t       cols;
+
+			str = clui_shell_match_printable(matches[m + 1], &len);
+			clui_shell_render(&render, str, len);
+
+			if ((m + row_nr) >= cnt)
+				continue;
+
+			/*
+			 * Readline computes max on its own when listing
+			 * matches it built: never let a wider match make the
+			 * padding wrap around.
+			 */
+			cols = clui_shell_match_cols(str, len);
+			clui_shell_render_pad(&render,
+			                      (cols < (size_t)max) ?
+			                      (width - cols) : 2);
+		}
+
+		clui_shell_render(&render, "\n", 1);
+	}
+
+	if (cnt < (unsigned int)nr) {
+		char trailer[64];
+		int  len;
+
+		len = snprintf(trailer,
+		               sizeof(trailer),
+		               "(%u more candidates)\n",
+		               nr - cnt);
+		clui_shell_render(&render, trailer, len);
+	}
+
+	clui_shell_flush_render(&render);
+
+	rl_forced_update_display();
 }
 
 static char ** __clui_nonull(1)
@@ -597,31 +2717,45 @@ clui_shell_complete(const char * word, int start, int end)
 	clui_assert(end <= rl_end);
 	clui_assert(strlen(word) == (size_t)(end - start));
 
+	clui_shell_record(CLUI_RECORD_COMPLETE_TYPE, rl_line_buffer, end);
+
+	/*
+	 * Restore readline post-processing of matches which
+	 * clui_shell_generate_matches() disables when not needed.
+	 */
+	clui_shell_clear_match_cache();
+	rl_sort_completion_matches = 1;
+	rl_ignore_completion_duplicates = 1;
+
 	if (start) {
 		char ** words;
-		char *  ln;
+		char    ln[LINE_MAX];
 		int     ret;
 		char ** matches;
 
 		if (end >= LINE_MAX)
 			return NULL;
 
-		ln = malloc(end + 1);
-		if (!ln)
-			return NULL;
-
 		memcpy(ln, rl_line_buffer, end);
 		ln[end] = '\0';
 
-		ret = clui_shell_break_expr(&words, ln, start);
+		ret = clui_shell_break_expr(&words,
+		                            CLUI_SHELL_CMPL_WORDS,
+		                            ln,
+		                            start);
 		if (ret > 0) {
+			/* Complete command following the timing prefix. */
+			int skip = clui_shell_timed_word(words[0]) ? 1 : 0;
+
 			matches = clui_the_shell.complete(word,
 			                                  end - start,
-			                                  ret,
+			                                  ret - skip,
+			                                  (ret > skip) ?
 			                                  (const char * const *)
-			                                  words,
+			                                  &words[skip] :
+			                                  NULL,
 			                                  clui_the_shell.data);
-			free(words);
+			clui_shell_free_words(words);
 		}
 		else if (!ret)
 			matches = clui_the_shell.complete(word,
@@ -632,8 +2766,6 @@ clui_shell_complete(const char * word, int start, int end)
 		else
 			matches = NULL;
 
-		free(ln);
-
 		return matches;
 	}
 
@@ -644,6 +2776,143 @@ clui_shell_complete(const char * word, int start, int end)
 	                               clui_the_shell.data);
 }
 
+#if defined(CONFIG_CLUI_SHELL_STATIC)
+
+static void
+clui_shell_substitute_word(int start, const char * text, bool append)
+{
+	rl_begin_undo_group();
+	rl_delete_text(start, rl_point);
+	rl_point = start;
+	rl_insert_text(text);
+	if (append)
+		rl_insert_text(" ");
+	rl_end_undo_group();
+}
+
+/*
+ * Completion command bound to the TAB key in place of readline's own one since
+ * the latter free(3)s matches returned by rl_attempted_completion_function.
+ * Words are delimited by blanks only, as in clui_shell_break_expr().
+ */
+static int
+clui_shell_complete_key(int count __unused, int key __unused)
+{
+	int          start = rl_point;
+	char         word[LINE_MAX];
+	char **      matches;
+	unsigned int nr;
+
+	while ((start > 0) &&
+	       !isspace((unsigned char)rl_line_buffer[start - 1]))
+		start--;
+
+	if ((rl_point - start) >= (int)sizeof(word))
+		goto ding;
+
+	memcpy(word, &rl_line_buffer[start], rl_point - start);
+	word[rl_point - start] = '\0';
+
+	rl_completion_suppress_append = 0;
+	matches = clui_shell_complete(word, start, rl_point);
+	if (!matches)
+		goto ding;
+
+	if (!matches[1]) {
+		/* Single match: substitute it to the word to complete. */
+		clui_shell_substitute_word(start,
+		                           matches[0],
+		                           !rl_completion_suppress_append);
+		return 0;
+	}
+
+	if (strlen(matches[0]) > (size_t)(rl_point - start)) {
+		/* Extend word up to the candidates common prefix. */
+		clui_shell_substitute_word(start, matches[0], false);
+		return 0;
+	}
+
+	if (rl_last_func != clui_shell_complete_key)
+		goto ding;
+
+	/* Consecutive completion requests: list candidates. */
+	for (nr = 1; matches[nr]; nr++)
+		;
+
+	clui_shell_display_matches(matches, nr - 1, 0);
+
+	return 0;
+
+ding:
+	rl_ding();
+
+	return 0;
+}
+
+static void
+clui_shell_init_completion(void)
+{
+	rl_bind_key('\t', clui_shell_complete_key);
+	rl_bind_key_in_map('\t', clui_shell_complete_key, vi_insertion_keymap);
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
+
+static void
+clui_shell_init_completion(void)
+{
+	rl_attempted_completion_function = clui_shell_complete;
+	rl_completion_display_matches_hook = clui_shell_display_matches;
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
+
+#if defined(CONFIG_CLUI_MEM_STATS)
+
+/* Account history entries owned by readline upon query. */
+static size_t
+clui_shell_probe_hist(void)
+{
+	HIST_ENTRY ** ents = history_list();
+	size_t        size;
+
+	if (!ents)
+		return 0;
+
+	size = clui_mem_size(ents);
+	for (; *ents; ents++)
+		size += clui_mem_size(*ents) + clui_mem_size((*ents)->line);
+
+	return size;
+}
+
+static void
+clui_shell_init_mem(bool enable_history)
+{
+	if (enable_history)
+		clui_mem_set_probe(CLUI_MEM_HIST_SYS, clui_shell_probe_hist);
+}
+
+static void
+clui_shell_fini_mem(void)
+{
+	clui_mem_set_probe(CLUI_MEM_HIST_SYS, NULL);
+}
+
+#else  /* !defined(CONFIG_CLUI_MEM_STATS) */
+
+static void
+clui_shell_init_mem(bool enable_history __unused)
+{
+}
+
+static void
+clui_shell_fini_mem(void)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_MEM_STATS) */
+
 void
 clui_shell_init(const char * restrict    name,
                 const char * restrict    prompt,
@@ -662,7 +2931,7 @@ clui_shell_init(const char * restrict    name,
 	clui_the_shell.shutdown = 0;
 
 	if (complete) {
-		rl_attempted_completion_function = clui_shell_complete;
+		clui_shell_init_completion();
 		rl_inhibit_completion = 0;
 	}
 	else
@@ -670,16 +2939,26 @@ clui_shell_init(const char * restrict    name,
 
 	if (enable_history) {
 		if (name) {
-			clui_the_shell.hist_path = clui_shell_hist_path(name);
+			clui_the_shell.hist_path = clui_shell_hist_path(
+				name,
+				clui_the_shell.hist_file);
 			if (clui_the_shell.hist_path)
-				read_history(clui_the_shell.hist_path);
+				clui_shell_start_hist_load(
+					clui_the_shell.hist_path);
 		}
 	}
 
 	if (name)
 		rl_readline_name = name;
 
-	rl_event_hook = clui_shell_handle_readline_events;
+	clui_shell_init_events();
+	clui_shell_init_paste();
+	clui_shell_init_mem(enable_history);
+
+	clui_shell_init_record(name,
+	                       prompt,
+	                       (enable_history ? CLUI_RECORD_HIST_FLAG : 0) |
+	                       (complete ? CLUI_RECORD_COMPLETE_FLAG : 0));
 }
 
 static void
@@ -688,14 +2967,21 @@ clui_shell_save_hist(void)
 	if (clui_the_shell.hist_path) {
 		clui_assert(clui_the_shell.hist);
 
-		write_history(clui_the_shell.hist_path);
+		/* Prevent from overwriting history not loaded yet. */
+		clui_shell_sync_hist(true);
 
-		free(clui_the_shell.hist_path);
+		write_history(clui_the_shell.hist_path);
 	}
 }
 
 void
 clui_shell_fini(void)
 {
+	clui_shell_stop_record();
+	clui_shell_fini_jobs();
+	clui_shell_drop_paste();
 	clui_shell_save_hist();
+	clui_shell_clear_path_cache();
+	clui_shell_fini_events();
+	clui_shell_fini_mem();
 }
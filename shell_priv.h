@@ -0,0 +1,218 @@
+#ifndef _CLUI_SHELL_PRIV_H
+#define _CLUI_SHELL_PRIV_H
+
+#include <clui/shell.h>
+#include <errno.h>
+
+/* Completion candidate along with its length and fuzzy matching score. */
+struct clui_shell_cand {
+	char *       str;
+	unsigned int len;
+	int          score;
+};
+
+struct clui_shell_gen {
+	const char *             word;
+	size_t                   len;
+	struct clui_shell_cand * cands;
+	unsigned int             nr;
+	unsigned int             max;
+	unsigned int             size;
+	size_t                   used;
+	size_t                   lcd;
+	bool                     truncated;
+	bool                     fuzzy;
+};
+
+extern char *
+clui_shell_join_expr(const struct clui_shell_expr * expr) __clui_nonull(1);
+
+extern int
+clui_shell_parse_expr(struct clui_shell_expr * expr, char * ln)
+	__clui_nonull(1, 2);
+
+extern void
+clui_shell_commit_expr(const struct clui_shell_expr * expr) __clui_nonull(1);
+
+/*
+ * Have the shell write queued messages and background job notices out at
+ * next batch.
+ */
+extern void
+clui_shell_schedule_prints(void);
+
+#if defined(CONFIG_CLUI_SHELL_BULK_PASTE)
+
+extern void
+clui_shell_bulk_input(bool on);
+
+extern int
+clui_shell_pop_paste(struct clui_shell_expr * expr) __clui_nonull(1);
+
+extern void
+clui_shell_commit_paste(void);
+
+extern void
+clui_shell_drop_paste(void);
+
+extern void
+clui_shell_init_paste(void);
+
+#else  /* !defined(CONFIG_CLUI_SHELL_BULK_PASTE) */
+
+static inline int
+clui_shell_pop_paste(struct clui_shell_expr * expr __unused)
+{
+	return -ENOENT;
+}
+
+static inline void
+clui_shell_commit_paste(void)
+{
+}
+
+static inline void
+clui_shell_drop_paste(void)
+{
+}
+
+static inline void
+clui_shell_init_paste(void)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_BULK_PASTE) */
+
+#if defined(CONFIG_CLUI_SHELL_JOBS)
+
+extern int
+clui_shell_jobs_builtin(const struct clui_shell_expr * expr) __clui_nonull(1);
+
+extern int
+clui_shell_wait_builtin(const struct clui_shell_expr * expr) __clui_nonull(1);
+
+extern int
+clui_shell_kill_builtin(const struct clui_shell_expr * expr) __clui_nonull(1);
+
+extern void
+clui_shell_report_jobs(void);
+
+extern void
+clui_shell_fini_jobs(void);
+
+#else  /* !defined(CONFIG_CLUI_SHELL_JOBS) */
+
+static inline void
+clui_shell_report_jobs(void)
+{
+}
+
+static inline void
+clui_shell_fini_jobs(void)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_JOBS) */
+
+extern int
+clui_shell_run_expr(struct clui_parser *           parser,
+                    const struct clui_opt_set *    set,
+                    const struct clui_cmd *        cmd,
+                    const struct clui_exec_ops *   ops,
+                    const struct clui_shell_expr * expr,
+                    void *                         data)
+	__clui_nonull(1, 4, 5);
+
+#if defined(CONFIG_CLUI_SHELL_TIME)
+
+extern bool
+clui_shell_timed_word(const char * word) __clui_nonull(1);
+
+extern int
+clui_shell_time_expr(struct clui_parser *           parser,
+                     const struct clui_opt_set *    set,
+                     const struct clui_cmd *        cmd,
+                     const struct clui_exec_ops *   ops,
+                     const struct clui_shell_expr * expr,
+                     void *                         data)
+	__clui_nonull(1, 4, 5);
+
+#else  /* !defined(CONFIG_CLUI_SHELL_TIME) */
+
+static inline bool
+clui_shell_timed_word(const char * word __unused)
+{
+	return false;
+}
+
+static inline int
+clui_shell_time_expr(struct clui_parser *           parser __unused,
+                     const struct clui_opt_set *    set __unused,
+                     const struct clui_cmd *        cmd __unused,
+                     const struct clui_exec_ops *   ops __unused,
+                     const struct clui_shell_expr * expr __unused,
+                     void *                         data __unused)
+{
+	clui_assert(0);
+
+	return -ENOSYS;
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_TIME) */
+
+#if defined(CONFIG_CLUI_SHELL_RECORD)
+
+extern void
+clui_shell_record(unsigned int type, const char * data, size_t len);
+
+extern void
+clui_shell_init_record(const char * name,
+                       const char * prompt,
+                       unsigned int flags);
+
+/*
+ * Install readline input character fetcher underneath the recorder when a
+ * recording is in progress so that input remains recorded.
+ */
+extern void
+clui_shell_install_getc(rl_getc_func_t * getc) __clui_nonull(1);
+
+#else  /* !defined(CONFIG_CLUI_SHELL_RECORD) */
+
+static inline void
+clui_shell_record(unsigned int type __unused,
+                  const char * data __unused,
+                  size_t       len __unused)
+{
+}
+
+static inline void
+clui_shell_init_record(const char * name __unused,
+                       const char * prompt __unused,
+                       unsigned int flags __unused)
+{
+}
+
+static inline void
+clui_shell_stop_record(void)
+{
+}
+
+static inline void
+clui_shell_install_getc(rl_getc_func_t * getc)
+{
+	rl_getc_function = getc;
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_RECORD) */
+
+#if !defined(CONFIG_CLUI_SHELL_PATH)
+
+static inline void
+clui_shell_clear_path_cache(void)
+{
+}
+
+#endif /* !defined(CONFIG_CLUI_SHELL_PATH) */
+
+#endif /* _CLUI_SHELL_PRIV_H */
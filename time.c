@@ -0,0 +1,257 @@
+#include "shell_priv.h"
+#include "mem_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+static bool clui_shell_time_on;
+
+void
+clui_shell_enable_time(bool on)
+{
+	clui_shell_time_on = on;
+}
+
+bool __clui_nonull(1)
+clui_shell_timed_word(const char * word)
+{
+	return clui_shell_time_on && !strcmp(word, "time");
+}
+
+/* Resource usage snapshot taken around a timed command. */
+struct clui_shell_time_stamp {
+	struct timespec    wall;
+	struct rusage      usage;
+	unsigned long      allocs;
+	unsigned long long wchar;
+	bool               io;
+};
+
+/*
+ * Fetch the number of bytes the calling thread wrote so far, whatever the
+ * file descriptor, from /proc/thread-self/io.
+ */
+static bool
+clui_shell_time_wchar(unsigned long long * wchar)
+{
+	char         buff[512];
+	int          fd;
+	ssize_t      ret;
+	const char * str;
+
+	fd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	do {
+		ret = read(fd, buff, sizeof(buff) - 1);
+	} while ((ret < 0) && (errno == EINTR));
+
+	close(fd);
+
+	if (ret <= 0)
+		return false;
+	buff[ret] = '\0';
+
+	str = strstr(buff, "wchar:");
+	if (!str)
+		return false;
+
+	*wchar = strtoull(&str[sizeof("wchar:") - 1], NULL, 10);
+
+	return true;
+}
+
+#if defined(CONFIG_CLUI_MEM_STATS)
+
+static unsigned long
+clui_shell_time_allocs(void)
+{
+	return clui_mem_thread_allocs();
+}
+
+#else  /* !defined(CONFIG_CLUI_MEM_STATS) */
+
+static unsigned long
+clui_shell_time_allocs(void)
+{
+	return 0;
+}
+
+#endif /* defined(CONFIG_CLUI_MEM_STATS) */
+
+static void
+clui_shell_stamp_time(struct clui_shell_time_stamp * stamp)
+{
+	/* Account for output buffered so far. */
+	fflush(stdout);
+
+	stamp->io = clui_shell_time_wchar(&stamp->wchar);
+	stamp->allocs = clui_shell_time_allocs();
+	getrusage(RUSAGE_THREAD, &stamp->usage);
+	clock_gettime(CLOCK_MONOTONIC, &stamp->wall);
+}
+
+static long long
+clui_shell_time_spec_usec(const struct timespec * start,
+                          const struct timespec * end)
+{
+	return ((long long)(end->tv_sec - start->tv_sec) * 1000000LL) +
+	       ((end->tv_nsec - start->tv_nsec) / 1000L);
+}
+
+static long long
+clui_shell_time_val_usec(const struct timeval * start,
+                         const struct timeval * end)
+{
+	return ((long long)(end->tv_sec - start->tv_sec) * 1000000LL) +
+	       (end->tv_usec - start->tv_usec);
+}
+
+static void
+clui_shell_print_time(const char * label, long long usec)
+{
+	fprintf(stderr,
+	        "%-7s%lld.%06llds\n",
+	        label,
+	        usec / 1000000LL,
+	        usec % 1000000LL);
+}
+
+/*
+ * Parse and execute times are reported only when the command was parsed
+ * successfully, i.e. when parsed is not NULL.
+ */
+static void
+clui_shell_report_time(const struct clui_shell_time_stamp * start,
+                       const struct timespec *              parsed,
+                       const struct clui_shell_time_stamp * end)
+{
+	clui_shell_print_time("real",
+	                      clui_shell_time_spec_usec(&start->wall,
+	                                                &end->wall));
+	if (parsed) {
+		clui_shell_print_time("parse",
+		                      clui_shell_time_spec_usec(&start->wall,
+		                                                parsed));
+		clui_shell_print_time("exec",
+		                      clui_shell_time_spec_usec(parsed,
+		                                                &end->wall));
+	}
+	clui_shell_print_time("user",
+	                      clui_shell_time_val_usec(&start->usage.ru_utime,
+	                                               &end->usage.ru_utime));
+	clui_shell_print_time("sys",
+	                      clui_shell_time_val_usec(&start->usage.ru_stime,
+	                                               &end->usage.ru_stime));
+
+#if defined(CONFIG_CLUI_MEM_STATS)
+	fprintf(stderr, "%-7s%lu\n", "allocs", end->allocs - start->allocs);
+#endif /* defined(CONFIG_CLUI_MEM_STATS) */
+
+	if (start->io && end->io)
+		fprintf(stderr,
+		        "%-7s%llu bytes\n",
+		        "output",
+		        end->wchar - start->wchar);
+}
+
+/*
+ * Timed command run state: ops and data given by the caller, along with the
+ * time parsing completed at.
+ */
+struct clui_shell_time_run {
+	const struct clui_exec_ops * ops;
+	void *                       data;
+	struct timespec              parsed;
+	bool                         exec;
+};
+
+static int
+clui_shell_time_init(void * ctx, void * data)
+{
+	const struct clui_shell_time_run * run = data;
+
+	if (!run->ops->init)
+		return 0;
+
+	return run->ops->init(ctx, run->data);
+}
+
+static int
+clui_shell_time_exec(void * ctx, void * data)
+{
+	struct clui_shell_time_run * run = data;
+
+	clock_gettime(CLOCK_MONOTONIC, &run->parsed);
+	run->exec = true;
+
+	return run->ops->exec(ctx, run->data);
+}
+
+static void
+clui_shell_time_fini(void * ctx, void * data)
+{
+	const struct clui_shell_time_run * run = data;
+
+	if (run->ops->fini)
+		run->ops->fini(ctx, run->data);
+}
+
+int __clui_nonull(1, 4, 5)
+clui_shell_time_expr(struct clui_parser *           parser,
+                     const struct clui_opt_set *    set,
+                     const struct clui_cmd *        cmd,
+                     const struct clui_exec_ops *   ops,
+                     const struct clui_shell_expr * expr,
+                     void *                         data)
+{
+	clui_assert_exec_ops(ops);
+	clui_assert(expr);
+	clui_assert(expr->nr);
+	clui_assert(clui_shell_timed_word(expr->words[0]));
+
+	const struct clui_shell_expr timed = {
+		.nr    = expr->nr - 1,
+		.words = &expr->words[1],
+		.ln    = expr->ln
+	};
+	struct clui_shell_time_run   run = {
+		.ops  = ops,
+		.data = data,
+		.exec = false
+	};
+	const struct clui_exec_ops   time_ops = {
+		.ctx_size = ops->ctx_size,
+		.init     = clui_shell_time_init,
+		.exec     = clui_shell_time_exec,
+		.fini     = clui_shell_time_fini
+	};
+	struct clui_shell_time_stamp start;
+	struct clui_shell_time_stamp end;
+	int                          ret;
+
+	if (!timed.nr) {
+		fprintf(stderr, "time: missing command.\n");
+		return -EINVAL;
+	}
+
+	clui_shell_stamp_time(&start);
+
+	ret = clui_shell_run_expr(parser,
+	                          set,
+	                          cmd,
+	                          &time_ops,
+	                          &timed,
+	                          &run);
+
+	clui_shell_stamp_time(&end);
+
+	clui_shell_report_time(&start, run.exec ? &run.parsed : NULL, &end);
+
+	return ret;
+}
@@ -0,0 +1,374 @@
+/*
+ * End-to-end interactive latency benchmark.
+ *
+ * Drives clui-bench-shell instances through a local pseudo-terminal and
+ * measures the time elapsed between keystrokes and terminal output for
+ * completion, history recall and command dispatch with synthetic command
+ * tables of varying size.
+ */
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#define CLUI_BENCH_PROMPT "bench> "
+
+struct clui_bench_conf {
+	const char * shell;
+	unsigned int vals_nr;
+	unsigned int hist_nr;
+	unsigned int iters;
+	int          idle;
+	int          tmout;
+};
+
+static int
+clui_bench_type(const struct clui_tool_pty *   pty,
+                const struct clui_bench_conf * conf,
+                const char *                   keys,
+                struct clui_tool_match *       match,
+                uint64_t *                     lat)
+{
+	size_t   len = strlen(keys);
+	uint64_t sent;
+	uint64_t first = 0;
+	uint64_t last = 0;
+	int      ret;
+
+	sent = clui_tool_now_usec();
+	if (write(pty->fd, keys, len) != (ssize_t)len)
+		return -errno;
+
+	ret = clui_tool_wait_output(pty,
+	                            match,
+	                            match ? conf->tmout : conf->idle,
+	                            conf->tmout,
+	                            &first,
+	                            &last);
+	if (match ? ret : (ret != -ETIME))
+		return ret;
+
+	if (lat) {
+		if (!last)
+			return -ENODATA;
+		*lat = last - sent;
+	}
+
+	return 0;
+}
+
+static int
+clui_bench_sample(const struct clui_tool_pty *   pty,
+                  const struct clui_bench_conf * conf,
+                  const char *                   prolog,
+                  const char *                   keys,
+                  struct clui_tool_match *       match,
+                  struct clui_tool_stats *       stats)
+{
+	uint64_t lat;
+	int      ret;
+
+	if (prolog) {
+		ret = clui_bench_type(pty, conf, prolog, NULL, NULL);
+		if (ret)
+			return ret;
+	}
+
+	ret = clui_bench_type(pty, conf, keys, match, &lat);
+	if (ret)
+		return ret;
+
+	return clui_tool_add_sample(stats, lat);
+}
+
+static int
+clui_bench_write_hist(const char * dir, const struct clui_bench_conf * conf)
+{
+	char *       path;
+	FILE *       stdio;
+	unsigned int h;
+
+	if (asprintf(&path, "%s/clui-bench", dir) < 0)
+		return -ENOMEM;
+	if (mkdir(path, S_IRWXU) && (errno != EEXIST)) {
+		free(path);
+		return -errno;
+	}
+	free(path);
+
+	if (asprintf(&path, "%s/clui-bench/history", dir) < 0)
+		return -ENOMEM;
+	stdio = fopen(path, "w");
+	free(path);
+	if (!stdio)
+		return -errno;
+
+	for (h = 0; h < conf->hist_nr; h++)
+		fprintf(stdio, "cmd%06u kw000000 val%06u\n", h % 10, h);
+
+	return fclose(stdio) ? -errno : 0;
+}
+
+static void
+clui_bench_clean_hist(const char * dir)
+{
+	char * path;
+
+	if (asprintf(&path, "%s/clui-bench/history", dir) > 0) {
+		unlink(path);
+		free(path);
+	}
+
+	if (asprintf(&path, "%s/clui-bench", dir) > 0) {
+		rmdir(path);
+		free(path);
+	}
+
+	rmdir(dir);
+}
+
+static int
+clui_bench_run(const struct clui_bench_conf * conf, unsigned int cmds_nr)
+{
+	char                   cmds[16];
+	char                   vals[16];
+	char * const           argv[] = {
+		(char *)conf->shell, "-c", cmds, "-v", vals, NULL
+	};
+	struct clui_tool_pty   pty;
+	struct clui_tool_match match;
+	struct clui_tool_stats start = CLUI_TOOL_INIT_STATS("startup");
+	struct clui_tool_stats cmpl = CLUI_TOOL_INIT_STATS("complete-cmd");
+	struct clui_tool_stats vcmpl = CLUI_TOOL_INIT_STATS("complete-val");
+	struct clui_tool_stats hist = CLUI_TOOL_INIT_STATS("history");
+	struct clui_tool_stats disp = CLUI_TOOL_INIT_STATS("dispatch");
+	uint64_t               sent;
+	uint64_t               first;
+	uint64_t               last = 0;
+	unsigned int           i;
+	int                    ret;
+
+	sprintf(cmds, "%u", cmds_nr);
+	sprintf(vals, "%u", conf->vals_nr);
+
+	clui_tool_init_match(&match, CLUI_BENCH_PROMPT);
+
+	sent = clui_tool_now_usec();
+	ret = clui_tool_spawn(&pty, argv);
+	if (ret)
+		return ret;
+
+	ret = clui_tool_wait_output(&pty,
+	                            &match,
+	                            conf->tmout,
+	                            conf->tmout,
+	                            &first,
+	                            &last);
+	if (ret)
+		goto reap;
+	clui_tool_add_sample(&start, last - sent);
+
+	for (i = 0; !ret && (i < conf->iters); i++) {
+		char line[64];
+
+		/* List all commands, then clear line. */
+		ret = clui_bench_sample(&pty, conf, "cmd", "\t\t", NULL, &cmpl);
+		if (!ret)
+			ret = clui_bench_type(&pty, conf, "\025", NULL, NULL);
+
+		/* List all values of a keyword parameter. */
+		if (!ret)
+			ret = clui_bench_sample(&pty,
+			                        conf,
+			                        "cmd000000 kw000000 ",
+			                        "\t\t",
+			                        NULL,
+			                        &vcmpl);
+		if (!ret)
+			ret = clui_bench_type(&pty, conf, "\025", NULL, NULL);
+
+		/* Run a command and wait for next prompt. */
+		sprintf(line, "cmd%06u kw000000 val%06u", i % cmds_nr, i);
+		if (!ret)
+			ret = clui_bench_sample(&pty,
+			                        conf,
+			                        line,
+			                        "\r",
+			                        &match,
+			                        &disp);
+
+		/* Recall previous history entry, then clear line. */
+		if (!ret)
+			ret = clui_bench_sample(&pty,
+			                        conf,
+			                        NULL,
+			                        "\033[A",
+			                        NULL,
+			                        &hist);
+		if (!ret)
+			ret = clui_bench_type(&pty, conf, "\025", NULL, NULL);
+	}
+
+	printf("commands=%u values=%u history=%u\n",
+	       cmds_nr,
+	       conf->vals_nr,
+	       conf->hist_nr);
+	clui_tool_report_stats(&start, stdout);
+	clui_tool_report_stats(&cmpl, stdout);
+	clui_tool_report_stats(&vcmpl, stdout);
+	clui_tool_report_stats(&hist, stdout);
+	clui_tool_report_stats(&disp, stdout);
+
+reap:
+	if (write(pty.fd, "\004", 1) == 1)
+		clui_tool_wait_output(&pty,
+		                      NULL,
+		                      conf->idle,
+		                      conf->tmout,
+		                      &first,
+		                      &last);
+	clui_tool_reap(&pty, conf->tmout);
+
+	clui_tool_fini_stats(&disp);
+	clui_tool_fini_stats(&hist);
+	clui_tool_fini_stats(&vcmpl);
+	clui_tool_fini_stats(&cmpl);
+	clui_tool_fini_stats(&start);
+
+	return ret;
+}
+
+static void
+clui_bench_usage(FILE * stdio, const char * me)
+{
+	fprintf(stdio,
+	        "Usage: %s [OPTIONS]\n"
+	        "Measure interactive latencies of clui-bench-shell.\n"
+	        "\n"
+	        "With OPTIONS:\n"
+	        "    -s|--sizes LIST      comma separated numbers of "
+	        "commands [10,1000,100000]\n"
+	        "    -v|--values NR       number of keyword values [1000]\n"
+	        "    -H|--history NR      number of history entries [10000]\n"
+	        "    -n|--iterations NR   number of samples per measure [50]\n"
+	        "    -i|--idle MSEC       output idle delay [20]\n"
+	        "    -t|--timeout MSEC    output timeout [10000]\n"
+	        "    -S|--shell PATH      shell to benchmark "
+	        "[clui-bench-shell]\n"
+	        "    -h|--help            this help message\n",
+	        me);
+}
+
+int
+main(int argc, char * const argv[])
+{
+	static const struct option opts[] = {
+		{ "sizes",      required_argument, NULL, 's' },
+		{ "values",     required_argument, NULL, 'v' },
+		{ "history",    required_argument, NULL, 'H' },
+		{ "iterations", required_argument, NULL, 'n' },
+		{ "idle",       required_argument, NULL, 'i' },
+		{ "timeout",    required_argument, NULL, 't' },
+		{ "shell",      required_argument, NULL, 'S' },
+		{ "help",       no_argument,       NULL, 'h' },
+		{ NULL,         0,                 NULL, 0 }
+	};
+	struct clui_bench_conf conf = {
+		.shell   = "clui-bench-shell",
+		.vals_nr = 1000,
+		.hist_nr = 10000,
+		.iters   = 50,
+		.idle    = 20,
+		.tmout   = 10000
+	};
+	char                   sizes[256] = "10,1000,100000";
+	char                   dir[] = "/tmp/clui-bench.XXXXXX";
+	char *                 size;
+	char *                 save;
+	int                    ret = 0;
+
+	while (true) {
+		int opt = getopt_long(argc, argv, "s:v:H:n:i:t:S:h", opts, NULL);
+
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 's':
+			strncpy(sizes, optarg, sizeof(sizes) - 1);
+			break;
+		case 'v':
+			conf.vals_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			conf.hist_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			conf.iters = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			conf.idle = atoi(optarg);
+			break;
+		case 't':
+			conf.tmout = atoi(optarg);
+			break;
+		case 'S':
+			conf.shell = optarg;
+			break;
+		case 'h':
+			clui_bench_usage(stdout, argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			clui_bench_usage(stderr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ((optind != argc) || (conf.idle <= 0) || (conf.tmout <= 0)) {
+		clui_bench_usage(stderr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	/* Run shells with their own history file. */
+	if (!mkdtemp(dir) ||
+	    setenv("XDG_CONFIG_HOME", dir, 1) ||
+	    clui_bench_write_hist(dir, &conf)) {
+		fprintf(stderr,
+		        "%s: cannot setup history: %s.\n",
+		        argv[0],
+		        strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	for (size = strtok_r(sizes, ",", &save);
+	     size;
+	     size = strtok_r(NULL, ",", &save)) {
+		unsigned long nr = strtoul(size, NULL, 0);
+
+		if (!nr || (nr > 999999)) {
+			fprintf(stderr,
+			        "%s: invalid number of commands '%s'.\n",
+			        argv[0],
+			        size);
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = clui_bench_run(&conf, nr);
+		if (ret) {
+			fprintf(stderr,
+			        "%s: benchmark failed: %s.\n",
+			        argv[0],
+			        strerror(-ret));
+			break;
+		}
+	}
+
+	clui_bench_clean_hist(dir);
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+/*
+ * Synthetic interactive shell driven by clui-bench.
+ *
+ * Commands are named cmd<N>. Each accepts keyword parameters named kw<N>
+ * whose values, named val<N>, are completed thanks to a generator.
+ */
+#include <clui/shell.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+struct clui_bench {
+	unsigned int                   cmds_nr;
+	char **                        cmds;
+	unsigned int                   kwords_nr;
+	struct clui_kword_parm *       kwords;
+	struct clui_shell_kword_parm * shell_kwords;
+	const struct clui_shell_kword_parm ** shell_parms;
+	const struct clui_kword_parm **       parms;
+	unsigned int                   vals_nr;
+};
+
+static struct clui_bench clui_the_bench;
+
+static int
+clui_bench_parse_kword(const struct clui_cmd * cmd __unused,
+                       struct clui_parser *    parser __unused,
+                       const char *            arg,
+                       void *                  ctx)
+{
+	unsigned int * cnt = ctx;
+
+	if (strncmp(arg, "val", 3))
+		return -EINVAL;
+
+	(*cnt)++;
+
+	return 0;
+}
+
+static int
+clui_bench_parse_cmd(const struct clui_cmd * cmd,
+                     struct clui_parser *    parser,
+                     int                     argc,
+                     char * const *          argv,
+                     void *                  ctx)
+{
+	if (!argc)
+		return 0;
+
+	return clui_parse_all_kword_parms(cmd,
+	                                  parser,
+	                                  clui_the_bench.parms,
+	                                  clui_the_bench.kwords_nr,
+	                                  argc,
+	                                  argv,
+	                                  ctx);
+}
+
+static void
+clui_bench_help_cmd(const struct clui_cmd *    cmd __unused,
+                    const struct clui_parser * parser __unused,
+                    FILE *                     stdio)
+{
+	fputs("Usage: cmd<N> [kw<N> val<N>]...\n", stdio);
+}
+
+static const struct clui_cmd clui_bench_cmd = {
+	.parse = clui_bench_parse_cmd,
+	.help  = clui_bench_help_cmd
+};
+
+static int
+clui_bench_generate_vals(struct clui_shell_gen * gen, void * data __unused)
+{
+	unsigned int v;
+
+	for (v = 0; v < clui_the_bench.vals_nr; v++) {
+		char buff[16];
+		int  len;
+		int  ret;
+
+		len = sprintf(buff, "val%06u", v);
+		ret = clui_shell_yield(gen, buff, len);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static char **
+clui_bench_complete(const char *       word,
+                    size_t             len,
+                    int                argc,
+                    const char * const argv[],
+                    void *             data)
+{
+	if (!argc)
+		return clui_shell_build_static_matches(
+			word,
+			len,
+			(const char * const *)clui_the_bench.cmds,
+			clui_the_bench.cmds_nr);
+
+	return clui_shell_build_kword_matches(word,
+	                                      len,
+	                                      clui_the_bench.shell_parms,
+	                                      clui_the_bench.kwords_nr,
+	                                      argc - 1,
+	                                      &argv[1],
+	                                      data);
+}
+
+static char *
+clui_bench_label(const char * prefix, unsigned int index)
+{
+	char * label;
+
+	if (asprintf(&label, "%s%06u", prefix, index) < 0)
+		return NULL;
+
+	return label;
+}
+
+static int
+clui_bench_init(unsigned int cmds_nr,
+                unsigned int kwords_nr,
+                unsigned int vals_nr)
+{
+	struct clui_bench * bench = &clui_the_bench;
+	unsigned int        n;
+
+	bench->cmds_nr = cmds_nr;
+	bench->kwords_nr = kwords_nr;
+	bench->vals_nr = vals_nr;
+
+	bench->cmds = calloc(cmds_nr, sizeof(bench->cmds[0]));
+	bench->kwords = calloc(kwords_nr, sizeof(bench->kwords[0]));
+	bench->shell_kwords = calloc(kwords_nr, sizeof(bench->shell_kwords[0]));
+	bench->parms = calloc(kwords_nr, sizeof(bench->parms[0]));
+	bench->shell_parms = calloc(kwords_nr, sizeof(bench->shell_parms[0]));
+	if (!bench->cmds ||
+	    !bench->kwords ||
+	    !bench->shell_kwords ||
+	    !bench->parms ||
+	    !bench->shell_parms)
+		return -ENOMEM;
+
+	for (n = 0; n < cmds_nr; n++) {
+		bench->cmds[n] = clui_bench_label("cmd", n);
+		if (!bench->cmds[n])
+			return -ENOMEM;
+	}
+
+	for (n = 0; n < kwords_nr; n++) {
+		size_t len;
+
+		bench->kwords[n].label = clui_bench_label("kw", n);
+		if (!bench->kwords[n].label)
+			return -ENOMEM;
+		bench->kwords[n].parse = clui_bench_parse_kword;
+		bench->kwords[n].hash = clui_hash_label(bench->kwords[n].label,
+		                                        &len);
+		bench->kwords[n].len = len;
+
+		bench->shell_kwords[n].clui = &bench->kwords[n];
+		bench->shell_kwords[n].gen = clui_bench_generate_vals;
+
+		bench->parms[n] = &bench->kwords[n];
+		bench->shell_parms[n] = &bench->shell_kwords[n];
+	}
+
+	return 0;
+}
+
+static int
+clui_bench_exec(struct clui_parser *           parser,
+                const struct clui_shell_expr * expr)
+{
+	unsigned int cnt = 0;
+	char *       end;
+	unsigned long idx;
+	int          ret;
+
+	if (strncmp(expr->words[0], "cmd", 3))
+		goto unknown;
+
+	idx = strtoul(&expr->words[0][3], &end, 10);
+	if (*end || (idx >= clui_the_bench.cmds_nr))
+		goto unknown;
+
+	ret = clui_parse_cmd(&clui_bench_cmd,
+	                     parser,
+	                     expr->nr - 1,
+	                     &expr->words[1],
+	                     &cnt);
+	if (ret)
+		return ret;
+
+	printf("%s: %u parameter(s)\n", expr->words[0], cnt);
+
+	return 0;
+
+unknown:
+	clui_err(parser, "unknown '%s' command.\n", expr->words[0]);
+
+	return -ENOENT;
+}
+
+int
+main(int argc, char * const argv[])
+{
+	struct clui_parser parser;
+	unsigned int       cmds_nr = 100;
+	unsigned int       kwords_nr = 8;
+	unsigned int       vals_nr = 100;
+	unsigned int       max = 0;
+	int                ret;
+
+	while (true) {
+		int opt = getopt(argc, argv, "c:k:v:m:");
+
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'c':
+			cmds_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			kwords_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			vals_nr = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			max = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr,
+			        "Usage: %s [-c CMDS] [-k KWORDS] [-v VALUES] "
+			        "[-m MAX_MATCHES]\n",
+			        argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!cmds_nr || !kwords_nr || clui_init(&parser, argc, argv))
+		return EXIT_FAILURE;
+
+	ret = clui_bench_init(cmds_nr, kwords_nr, vals_nr);
+	if (ret) {
+		fprintf(stderr, "%s: %s.\n", argv[0], strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	clui_shell_init("clui-bench",
+	                "bench> ",
+	                clui_bench_complete,
+	                NULL,
+	                true);
+	clui_shell_set_max_matches(max);
+
+	/* Never ask for confirmation nor page completion listings. */
+	rl_completion_query_items = 0;
+	rl_variable_bind("page-completions", "off");
+
+	while (true) {
+		struct clui_shell_expr expr;
+
+		ret = clui_shell_read_expr(&expr);
+		if (ret == -ESHUTDOWN)
+			break;
+		if (ret)
+			continue;
+
+		clui_bench_exec(&parser, &expr);
+		fflush(stdout);
+
+		clui_shell_free_expr(&expr);
+	}
+
+	clui_shell_fini();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+#include "common.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <pty.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+int
+clui_tool_spawn(struct clui_tool_pty * pty, char * const argv[])
+{
+	struct winsize win = {
+		.ws_row = 50,
+		.ws_col = 160
+	};
+	pid_t          pid;
+	int            fd;
+
+	pid = forkpty(&fd, NULL, NULL, &win);
+	if (pid < 0)
+		return -errno;
+
+	if (!pid) {
+		execvp(argv[0], argv);
+		fprintf(stderr,
+		        "%s: cannot execute: %s.\n",
+		        argv[0],
+		        strerror(errno));
+		_exit(EXIT_FAILURE);
+	}
+
+	pty->pid = pid;
+	pty->fd = fd;
+
+	return 0;
+}
+
+int
+clui_tool_reap(struct clui_tool_pty * pty, int timeout_msec)
+{
+	uint64_t end = clui_tool_now_usec() + ((uint64_t)timeout_msec * 1000);
+	int      stat;
+
+	close(pty->fd);
+
+	while (clui_tool_now_usec() < end) {
+		pid_t pid;
+
+		pid = waitpid(pty->pid, &stat, WNOHANG);
+		if (pid == pty->pid)
+			return WIFEXITED(stat) ? WEXITSTATUS(stat) : -EINTR;
+		if (pid < 0)
+			return -errno;
+
+		usleep(10000);
+	}
+
+	kill(pty->pid, SIGKILL);
+	waitpid(pty->pid, &stat, 0);
+
+	return -ETIMEDOUT;
+}
+
+uint64_t
+clui_tool_now_usec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static bool
+clui_tool_feed_match(struct clui_tool_match * match,
+                     const char *             data,
+                     size_t                   len)
+{
+	bool   found = false;
+	size_t b;
+
+	if (!match || !match->len)
+		return false;
+
+	for (b = 0; b < len; b++) {
+		if (data[b] == match->pattern[match->pos]) {
+			if (++match->pos == match->len) {
+				found = true;
+				match->pos = 0;
+			}
+		}
+		else
+			match->pos = (data[b] == match->pattern[0]) ? 1 : 0;
+	}
+
+	return found;
+}
+
+int
+clui_tool_wait_output(const struct clui_tool_pty * pty,
+                      struct clui_tool_match *     match,
+                      int                          idle_msec,
+                      int                          timeout_msec,
+                      uint64_t *                   first,
+                      uint64_t *                   last)
+{
+	uint64_t end = clui_tool_now_usec() + ((uint64_t)timeout_msec * 1000);
+	bool     seen = false;
+
+	while (true) {
+		struct pollfd pfd = {
+			.fd     = pty->fd,
+			.events = POLLIN
+		};
+		uint64_t      now = clui_tool_now_usec();
+		int           tmout;
+		char          buff[4096];
+		ssize_t       ret;
+
+		if (now >= end)
+			return -ETIMEDOUT;
+
+		tmout = (int)((end - now) / 1000);
+		if (tmout > idle_msec)
+			tmout = idle_msec;
+
+		ret = poll(&pfd, 1, tmout);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		if (!ret) {
+			if (tmout == idle_msec)
+				return -ETIME;
+			continue;
+		}
+
+		ret = read(pty->fd, buff, sizeof(buff));
+		if (ret <= 0)
+			/* Child exited. */
+			return -EPIPE;
+
+		now = clui_tool_now_usec();
+		if (!seen) {
+			*first = now;
+			seen = true;
+		}
+		*last = now;
+
+		if (clui_tool_feed_match(match, buff, ret))
+			return 0;
+	}
+}
+
+int
+clui_tool_add_sample(struct clui_tool_stats * stats, uint64_t usec)
+{
+	if (stats->nr == stats->size) {
+		size_t     size = stats->size ? (2 * stats->size) : 256;
+		uint64_t * tmp;
+
+		tmp = realloc(stats->samples, size * sizeof(tmp[0]));
+		if (!tmp)
+			return -errno;
+
+		stats->samples = tmp;
+		stats->size = size;
+	}
+
+	stats->samples[stats->nr++] = usec;
+
+	return 0;
+}
+
+static int
+clui_tool_cmp_samples(const void * first, const void * second)
+{
+	uint64_t a = *(const uint64_t *)first;
+	uint64_t b = *(const uint64_t *)second;
+
+	return (a > b) - (a < b);
+}
+
+static uint64_t
+clui_tool_percentile(const struct clui_tool_stats * stats, unsigned int pct)
+{
+	size_t idx = ((stats->nr - 1) * pct) / 100;
+
+	return stats->samples[idx];
+}
+
+void
+clui_tool_report_stats(struct clui_tool_stats * stats, FILE * stdio)
+{
+	uint64_t sum = 0;
+	size_t   s;
+
+	if (!stats->nr) {
+		fprintf(stdio, "%-12s n=0\n", stats->name);
+		return;
+	}
+
+	qsort(stats->samples,
+	      stats->nr,
+	      sizeof(stats->samples[0]),
+	      clui_tool_cmp_samples);
+
+	for (s = 0; s < stats->nr; s++)
+		sum += stats->samples[s];
+
+	fprintf(stdio,
+	        "%-12s n=%zu min=%llu avg=%llu p50=%llu p90=%llu p99=%llu "
+	        "max=%llu (usec)\n",
+	        stats->name,
+	        stats->nr,
+	        (unsigned long long)stats->samples[0],
+	        (unsigned long long)(sum / stats->nr),
+	        (unsigned long long)clui_tool_percentile(stats, 50),
+	        (unsigned long long)clui_tool_percentile(stats, 90),
+	        (unsigned long long)clui_tool_percentile(stats, 99),
+	        (unsigned long long)stats->samples[stats->nr - 1]);
+}
+
+void
+clui_tool_fini_stats(struct clui_tool_stats * stats)
+{
+	free(stats->samples);
+}
@@ -0,0 +1,77 @@
+#ifndef _CLUI_TOOL_COMMON_H
+#define _CLUI_TOOL_COMMON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+struct clui_tool_pty {
+	pid_t pid;
+	int   fd;
+};
+
+extern int
+clui_tool_spawn(struct clui_tool_pty * pty, char * const argv[]);
+
+extern int
+clui_tool_reap(struct clui_tool_pty * pty, int timeout_msec);
+
+extern uint64_t
+clui_tool_now_usec(void);
+
+/*
+ * Pattern matcher fed with output bytes, used to detect prompt display
+ * completion.
+ */
+struct clui_tool_match {
+	const char * pattern;
+	size_t       len;
+	size_t       pos;
+};
+
+static inline void
+clui_tool_init_match(struct clui_tool_match * match, const char * pattern)
+{
+	match->pattern = pattern;
+	match->len = pattern ? strlen(pattern) : 0;
+	match->pos = 0;
+}
+
+/*
+ * Wait for output produced by the child process.
+ *
+ * Return 0 once match pattern has been seen, -ETIME when no output has been
+ * received during idle_msec milliseconds and -ETIMEDOUT when overall
+ * timeout_msec milliseconds elapsed. first and last are set to the dates of
+ * first and last output bytes reception, or left untouched if none.
+ */
+extern int
+clui_tool_wait_output(const struct clui_tool_pty * pty,
+                      struct clui_tool_match *     match,
+                      int                          idle_msec,
+                      int                          timeout_msec,
+                      uint64_t *                   first,
+                      uint64_t *                   last);
+
+struct clui_tool_stats {
+	const char * name;
+	uint64_t *   samples;
+	size_t       nr;
+	size_t       size;
+};
+
+#define CLUI_TOOL_INIT_STATS(_name) \
+	{ .name = _name, .samples = NULL, .nr = 0, .size = 0 }
+
+extern int
+clui_tool_add_sample(struct clui_tool_stats * stats, uint64_t usec);
+
+extern void
+clui_tool_report_stats(struct clui_tool_stats * stats, FILE * stdio);
+
+extern void
+clui_tool_fini_stats(struct clui_tool_stats * stats);
+
+#endif /* _CLUI_TOOL_COMMON_H */
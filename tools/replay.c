@@ -0,0 +1,349 @@
+#include "common.h"
+#include "../record.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+
+/* Records closer than this are considered as part of the same input burst. */
+#define CLUI_REPLAY_BURST_USEC (2000U)
+
+struct clui_replay_rec {
+	unsigned int type;
+	uint64_t     delta;
+	size_t       len;
+	char *       data;
+};
+
+struct clui_replay {
+	char *                   name;
+	char *                   prompt;
+	unsigned int             flags;
+	struct clui_replay_rec * recs;
+	size_t                   nr;
+};
+
+static char *
+clui_replay_load_string(FILE * stdio)
+{
+	uint64_t len;
+	char *   str;
+
+	if (clui_record_load_varint(stdio, &len) || (len > 4096))
+		return NULL;
+
+	str = malloc(len + 1);
+	if (!str)
+		return NULL;
+
+	if (fread(str, 1, len, stdio) != len) {
+		free(str);
+		return NULL;
+	}
+
+	str[len] = '\0';
+
+	return str;
+}
+
+static int
+clui_replay_load(struct clui_replay * replay, const char * path)
+{
+	FILE * stdio;
+	char   magic[sizeof(CLUI_RECORD_MAGIC) - 1];
+	size_t size = 0;
+	int    ret = -EBADMSG;
+
+	replay->name = NULL;
+	replay->prompt = NULL;
+	replay->recs = NULL;
+	replay->nr = 0;
+
+	stdio = fopen(path, "re");
+	if (!stdio)
+		return -errno;
+
+	if ((fread(magic, 1, sizeof(magic), stdio) != sizeof(magic)) ||
+	    memcmp(magic, CLUI_RECORD_MAGIC, sizeof(magic)) ||
+	    (getc(stdio) != CLUI_RECORD_VERSION))
+		goto close;
+
+	replay->flags = getc(stdio);
+	replay->name = clui_replay_load_string(stdio);
+	replay->prompt = clui_replay_load_string(stdio);
+	if (!replay->name || !replay->prompt)
+		goto close;
+
+	while (true) {
+		struct clui_replay_rec * rec;
+		int                      type;
+		uint64_t                 len;
+
+		type = getc(stdio);
+		if (type == EOF)
+			break;
+
+		if (replay->nr == size) {
+			struct clui_replay_rec * tmp;
+
+			size = size ? (2 * size) : 1024;
+			tmp = realloc(replay->recs, size * sizeof(tmp[0]));
+			if (!tmp) {
+				ret = -ENOMEM;
+				goto close;
+			}
+
+			replay->recs = tmp;
+		}
+
+		rec = &replay->recs[replay->nr];
+		rec->type = type;
+		if (clui_record_load_varint(stdio, &rec->delta) ||
+		    clui_record_load_varint(stdio, &len) ||
+		    (len > (1U << 20)))
+			/* Truncated trailing record: ignore it. */
+			break;
+
+		rec->len = len;
+		rec->data = malloc(len + 1);
+		if (!rec->data) {
+			ret = -ENOMEM;
+			goto close;
+		}
+
+		if (fread(rec->data, 1, len, stdio) != len) {
+			free(rec->data);
+			break;
+		}
+		rec->data[len] = '\0';
+
+		replay->nr++;
+	}
+
+	ret = 0;
+
+close:
+	fclose(stdio);
+
+	return ret;
+}
+
+static const char *
+clui_replay_next_expr(const struct clui_replay * replay, size_t from)
+{
+	size_t r;
+
+	for (r = from; r < replay->nr; r++) {
+		if (replay->recs[r].type == CLUI_RECORD_EXPR_TYPE)
+			return replay->recs[r].data;
+		if (replay->recs[r].type == CLUI_RECORD_INPUT_TYPE)
+			break;
+	}
+
+	return NULL;
+}
+
+static void
+clui_replay_usage(FILE * stdio, const char * me)
+{
+	fprintf(stdio,
+	        "Usage: %s [OPTIONS] RECORD PROGRAM [ARGS...]\n"
+	        "Replay recorded session against PROGRAM run onto a "
+	        "pseudo-terminal and report\n"
+	        "per-keystroke and per-command latencies.\n"
+	        "\n"
+	        "With OPTIONS:\n"
+	        "    -r|--realtime         honor recorded inter-keystroke "
+	        "delays\n"
+	        "    -i|--idle MSEC        output idle delay [30]\n"
+	        "    -t|--timeout MSEC     command completion timeout "
+	        "[10000]\n"
+	        "    -p|--prompt PROMPT    prompt to detect [recorded "
+	        "prompt]\n"
+	        "    -v|--verbose          report each command latency\n"
+	        "    -h|--help             this help message\n",
+	        me);
+}
+
+int
+main(int argc, char * const argv[])
+{
+	static const struct option opts[] = {
+		{ "realtime", no_argument,       NULL, 'r' },
+		{ "idle",     required_argument, NULL, 'i' },
+		{ "timeout",  required_argument, NULL, 't' },
+		{ "prompt",   required_argument, NULL, 'p' },
+		{ "verbose",  no_argument,       NULL, 'v' },
+		{ "help",     no_argument,       NULL, 'h' },
+		{ NULL,       0,                 NULL, 0 }
+	};
+	bool                   realtime = false;
+	bool                   verbose = false;
+	int                    idle = 30;
+	int                    tmout = 10000;
+	const char *           prompt = NULL;
+	struct clui_replay     replay;
+	struct clui_tool_pty   pty;
+	struct clui_tool_match match;
+	struct clui_tool_stats start = CLUI_TOOL_INIT_STATS("startup");
+	struct clui_tool_stats keys = CLUI_TOOL_INIT_STATS("keystroke");
+	struct clui_tool_stats cplts = CLUI_TOOL_INIT_STATS("completion");
+	struct clui_tool_stats cmds = CLUI_TOOL_INIT_STATS("command");
+	uint64_t               first;
+	uint64_t               last;
+	uint64_t               sent;
+	size_t                 r;
+	int                    ret;
+
+	while (true) {
+		int opt = getopt_long(argc, argv, "ri:t:p:vh", opts, NULL);
+
+		if (opt < 0)
+			break;
+
+		switch (opt) {
+		case 'r':
+			realtime = true;
+			break;
+		case 'i':
+			idle = atoi(optarg);
+			break;
+		case 't':
+			tmout = atoi(optarg);
+			break;
+		case 'p':
+			prompt = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 'h':
+			clui_replay_usage(stdout, argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			clui_replay_usage(stderr, argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (((argc - optind) < 2) || (idle <= 0) || (tmout <= 0)) {
+		clui_replay_usage(stderr, argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ret = clui_replay_load(&replay, argv[optind]);
+	if (ret) {
+		fprintf(stderr,
+		        "%s: cannot load record '%s': %s.\n",
+		        argv[0],
+		        argv[optind],
+		        strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	clui_tool_init_match(&match, prompt ? prompt :
+	                             (*replay.prompt ? replay.prompt : NULL));
+
+	ret = clui_tool_spawn(&pty, &argv[optind + 1]);
+	if (ret) {
+		fprintf(stderr,
+		        "%s: cannot spawn '%s': %s.\n",
+		        argv[0],
+		        argv[optind + 1],
+		        strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	sent = clui_tool_now_usec();
+	if (!clui_tool_wait_output(&pty, &match, tmout, tmout, &first, &last))
+		clui_tool_add_sample(&start, last - sent);
+
+	r = 0;
+	while (r < replay.nr) {
+		const struct clui_replay_rec * rec = &replay.recs[r];
+		char                           burst[256];
+		size_t                         len = 0;
+		const char *                   expr;
+		bool                           cplt;
+
+		if (rec->type != CLUI_RECORD_INPUT_TYPE) {
+			r++;
+			continue;
+		}
+
+		if (realtime)
+			usleep(rec->delta);
+
+		/* Gather input bytes typed in a row, e.g. escape sequences. */
+		do {
+			burst[len++] = replay.recs[r++].data[0];
+		} while ((r < replay.nr) &&
+		         (len < sizeof(burst)) &&
+		         (replay.recs[r].type == CLUI_RECORD_INPUT_TYPE) &&
+		         (replay.recs[r].delta < CLUI_REPLAY_BURST_USEC));
+
+		cplt = (r < replay.nr) &&
+		       (replay.recs[r].type == CLUI_RECORD_COMPLETE_TYPE);
+		expr = clui_replay_next_expr(&replay, r);
+
+		sent = clui_tool_now_usec();
+		if (write(pty.fd, burst, len) != (ssize_t)len)
+			break;
+
+		first = last = 0;
+		if (expr) {
+			ret = clui_tool_wait_output(&pty,
+			                            &match,
+			                            tmout,
+			                            tmout,
+			                            &first,
+			                            &last);
+			if (!ret) {
+				clui_tool_add_sample(&cmds, last - sent);
+				if (verbose)
+					printf("%llu\t%s\n",
+					       (unsigned long long)
+					       (last - sent),
+					       expr);
+			}
+		}
+		else {
+			ret = clui_tool_wait_output(&pty,
+			                            NULL,
+			                            idle,
+			                            tmout,
+			                            &first,
+			                            &last);
+			if ((ret == -ETIME) && last)
+				clui_tool_add_sample(cplt ? &cplts : &keys,
+				                     last - sent);
+		}
+
+		if (ret == -EPIPE)
+			break;
+	}
+
+	/* Send end of stream in case recording did not include it. */
+	if (write(pty.fd, "\004", 1) == 1)
+		clui_tool_wait_output(&pty, NULL, idle, tmout, &first, &last);
+	ret = clui_tool_reap(&pty, tmout);
+
+	clui_tool_report_stats(&start, stdout);
+	clui_tool_report_stats(&keys, stdout);
+	clui_tool_report_stats(&cplts, stdout);
+	clui_tool_report_stats(&cmds, stdout);
+
+	clui_tool_fini_stats(&cmds);
+	clui_tool_fini_stats(&cplts);
+	clui_tool_fini_stats(&keys);
+	clui_tool_fini_stats(&start);
+
+	for (r = 0; r < replay.nr; r++)
+		free(replay.recs[r].data);
+	free(replay.recs);
+	free(replay.prompt);
+	free(replay.name);
+
+	return (ret == EXIT_SUCCESS) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
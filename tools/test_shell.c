@@ -0,0 +1,498 @@
+/*
+ * Interactive shell checks run against the built library.
+ *
+ * Each test builds completion matches the way completion callbacks do and
+ * checks what readline would be handed over. Exits with a non zero status
+ * when any check fails.
+ */
+#include <clui/shell.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <locale.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static unsigned int clui_test_failures;
+
+#define clui_test_expect(_cond) \
+	do { \
+		if (!(_cond)) { \
+			fprintf(stderr, \
+			        "%s:%d: %s: check '%s' failed.\n", \
+			        __FILE__, \
+			        __LINE__, \
+			        __func__, \
+			        # _cond); \
+			clui_test_failures++; \
+		} \
+	} while (0)
+
+static unsigned int
+clui_test_count_matches(char * const * matches)
+{
+	unsigned int nr = 0;
+
+	while (matches[nr])
+		nr++;
+
+	return nr;
+}
+
+#if defined(CONFIG_CLUI_SHELL_STATIC)
+
+/* Matches are stored into static buffers in heap-free builds. */
+static void
+clui_test_free_matches(char ** matches __unused)
+{
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_STATIC) */
+
+static void
+clui_test_free_matches(char ** matches)
+{
+	unsigned int m;
+
+	for (m = 0; matches[m]; m++)
+		free(matches[m]);
+	free(matches);
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_STATIC) */
+
+/*
+ * A single candidate retained out of a truncated list is not unique: the
+ * word must not be substituted with it.
+ */
+static void
+clui_test_truncated_single_match(void)
+{
+	static const char * const cands[] = { "alpha", "also" };
+	char **                   matches;
+
+	clui_shell_set_max_matches(1);
+
+	matches = clui_shell_build_static_matches("al", 2, cands, 2);
+	clui_test_expect(matches);
+	if (matches) {
+		clui_test_expect(clui_test_count_matches(matches) == 2);
+		clui_test_expect(!strcmp(matches[0], "al"));
+		clui_test_free_matches(matches);
+	}
+
+	/* Whereas a genuinely unique candidate is. */
+	matches = clui_shell_build_static_matches("alp", 3, cands, 2);
+	clui_test_expect(matches);
+	if (matches) {
+		clui_test_expect(clui_test_count_matches(matches) == 1);
+		clui_test_expect(!strcmp(matches[0], "alpha"));
+		clui_test_free_matches(matches);
+	}
+
+	clui_shell_set_max_matches(0);
+}
+
+/*
+ * Fuzzy matching keeps prefix completion behavior as long as all candidates
+ * start with the word to complete, including the empty one.
+ */
+static void
+clui_test_fuzzy_prefix_matches(void)
+{
+	static const char * const cands[] = { "shutdown", "show" };
+	char **                   matches;
+
+	clui_shell_set_fuzzy_matching(true);
+
+	matches = clui_shell_build_static_matches("", 0, cands, 2);
+	clui_test_expect(matches);
+	if (matches) {
+		clui_test_expect(clui_test_count_matches(matches) == 3);
+		clui_test_expect(!strcmp(matches[0], "sh"));
+		clui_test_expect(!strcmp(matches[1], "show"));
+		clui_test_expect(!strcmp(matches[2], "shutdown"));
+		clui_test_free_matches(matches);
+	}
+
+	/* Whereas candidates matching out of order disable it. */
+	matches = clui_shell_build_static_matches("sd", 2, cands, 2);
+	clui_test_expect(matches);
+	if (matches) {
+		clui_test_expect(clui_test_count_matches(matches) == 1);
+		clui_test_expect(!strcmp(matches[0], "shutdown"));
+		clui_test_free_matches(matches);
+	}
+
+	clui_shell_set_fuzzy_matching(false);
+}
+
+/*
+ * Render matches using the completion listing hook into a temporary file,
+ * passing max as readline computes it, and return rendered listing.
+ */
+static char *
+clui_test_list_matches(char ** matches, int max, size_t * size)
+{
+	FILE * stdio;
+	FILE * out = rl_outstream;
+	char * listing = NULL;
+	long   len;
+
+	stdio = tmpfile();
+	if (!stdio)
+		return NULL;
+
+	rl_outstream = stdio;
+	rl_completion_display_matches_hook(matches,
+	                                   clui_test_count_matches(matches) - 1,
+	                                   max);
+	rl_outstream = out;
+
+	fflush(stdio);
+	len = ftell(stdio);
+	if (len < 0)
+		goto close;
+
+	/* Don't load runaway listings. */
+	*size = (size_t)len;
+	if (*size > 4096)
+		goto close;
+
+	listing = malloc(*size + 1);
+	if (!listing)
+		goto close;
+
+	rewind(stdio);
+	if (fread(listing, 1, *size, stdio) != *size) {
+		free(listing);
+		listing = NULL;
+		goto close;
+	}
+	listing[*size] = '\0';
+
+close:
+	fclose(stdio);
+
+	return listing;
+}
+
+/*
+ * Rendered multibyte candidates are longer in bytes than the number of
+ * columns readline measures.
+ */
+static void
+clui_test_list_multibyte_matches(void)
+{
+	static const char * const cands[] = { "\xc3\xa9\xc3\xa9\xc3\xa9" "1",
+	                                      "\xc3\xa9\xc3\xa9\xc3\xa9" "2" };
+	char **                   matches;
+	char *                    listing;
+	size_t                    size = 0;
+
+	if (!setlocale(LC_CTYPE, "C.UTF-8")) {
+		fprintf(stderr, "%s: skipped: no UTF-8 locale.\n", __func__);
+		return;
+	}
+
+	matches = clui_shell_build_static_matches("\xc3\xa9", 2, cands, 2);
+	clui_test_expect(matches);
+	if (!matches)
+		goto locale;
+
+	/* Readline measures 4 columns. */
+	listing = clui_test_list_matches(matches, 4, &size);
+	clui_test_expect(listing);
+	if (listing) {
+		clui_test_expect(strstr(listing,
+		                        "\xc3\xa9\xc3\xa9\xc3\xa9" "1  "
+		                        "\xc3\xa9\xc3\xa9\xc3\xa9" "2\n"));
+		free(listing);
+	}
+	clui_test_expect(size <= 4096);
+
+	clui_test_free_matches(matches);
+
+locale:
+	setlocale(LC_CTYPE, "C");
+}
+
+#if defined(CONFIG_CLUI_SHELL_PATH)
+
+/*
+ * Rendered path candidates hold directory components that readline leaves
+ * out when measuring them.
+ */
+static void
+clui_test_list_path_matches(void)
+{
+	char    root[] = "/tmp/clui-test-XXXXXX";
+	char    cwd[PATH_MAX];
+	char ** matches;
+	char *  listing;
+	size_t  size = 0;
+
+	if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(root)) {
+		clui_test_expect(0);
+		return;
+	}
+
+	clui_test_expect(!chdir(root));
+	clui_test_expect(!mkdir("dir", 0700));
+	clui_test_expect(!mkdir("dir/alphadir", 0700));
+	clui_test_expect(!mkdir("dir/beta", 0700));
+
+	matches = clui_shell_build_path_matches("dir/", 4, NULL);
+	clui_test_expect(matches);
+	if (!matches)
+		goto clean;
+
+	clui_test_expect(clui_test_count_matches(matches) == 3);
+
+	/* Readline measures "alphadir/", i.e. 9 columns. */
+	listing = clui_test_list_matches(matches, 9, &size);
+	clui_test_expect(listing);
+	if (listing) {
+		clui_test_expect(strstr(listing, "alphadir/  beta/\n"));
+		free(listing);
+	}
+	clui_test_expect(size <= 4096);
+
+	clui_test_free_matches(matches);
+
+clean:
+	clui_shell_clear_path_cache();
+	rmdir("dir/beta");
+	rmdir("dir/alphadir");
+	rmdir("dir");
+	clui_test_expect(!chdir(cwd));
+	rmdir(root);
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_PATH) */
+
+static void
+clui_test_list_path_matches(void)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_PATH) */
+
+/* Words the root command was given, as parsed into the run context. */
+struct clui_test_run_ctx {
+	int  argc;
+	char words[64];
+};
+
+static int
+clui_test_parse_run(const struct clui_cmd * cmd __unused,
+                    struct clui_parser *    parser __unused,
+                    int                     argc,
+                    char * const *          argv,
+                    void *                  ctx)
+{
+	struct clui_test_run_ctx * run = ctx;
+	int                        a;
+
+	run->argc = argc;
+	for (a = 0; a < argc; a++) {
+		if (a)
+			strncat(run->words,
+			        " ",
+			        sizeof(run->words) - strlen(run->words) - 1);
+		strncat(run->words,
+		        argv[a],
+		        sizeof(run->words) - strlen(run->words) - 1);
+	}
+
+	return 0;
+}
+
+static void
+clui_test_help_run(const struct clui_cmd *    cmd __unused,
+                   const struct clui_parser * parser __unused,
+                   FILE *                     stdio __unused)
+{
+}
+
+static const struct clui_cmd clui_test_run_cmd = {
+	.parse = clui_test_parse_run,
+	.help  = clui_test_help_run
+};
+
+static int
+clui_test_exec_run(void * ctx, void * data)
+{
+	*(struct clui_test_run_ctx *)data = *(struct clui_test_run_ctx *)ctx;
+
+	return 0;
+}
+
+static const struct clui_exec_ops clui_test_run_ops = {
+	.ctx_size = sizeof(struct clui_test_run_ctx),
+	.exec     = clui_test_exec_run
+};
+
+static int
+clui_test_exec_expr(char **                    words,
+                    unsigned int               nr,
+                    struct clui_test_run_ctx * run)
+{
+	char * const           argv[] = { "clui-test", NULL };
+	struct clui_parser     parser;
+	struct clui_shell_expr expr = { .nr = nr, .words = words, .ln = NULL };
+
+	memset(run, 0, sizeof(*run));
+	clui_test_expect(!clui_init(&parser, 1, argv));
+
+	return clui_shell_exec_expr(&parser,
+	                            NULL,
+	                            &clui_test_run_cmd,
+	                            &clui_test_run_ops,
+	                            &expr,
+	                            run);
+}
+
+/* The root command is given all words of an expression, command one first. */
+static void
+clui_test_exec_words(void)
+{
+	char *                   words[] = { "show", "routes" };
+	struct clui_test_run_ctx run;
+
+	clui_test_expect(!clui_test_exec_expr(words, 2, &run));
+	clui_test_expect(run.argc == 2);
+	clui_test_expect(!strcmp(run.words, "show routes"));
+}
+
+#if defined(CONFIG_CLUI_SHELL_TIME)
+
+/* The timing prefix is a regular word until enabled, then stripped. */
+static void
+clui_test_exec_timed_words(void)
+{
+	char *                   words[] = { "time", "show", "routes" };
+	struct clui_test_run_ctx run;
+
+	clui_test_expect(!clui_test_exec_expr(words, 3, &run));
+	clui_test_expect(!strcmp(run.words, "time show routes"));
+
+	clui_shell_enable_time(true);
+	clui_test_expect(!clui_test_exec_expr(words, 3, &run));
+	clui_test_expect(run.argc == 2);
+	clui_test_expect(!strcmp(run.words, "show routes"));
+	clui_shell_enable_time(false);
+}
+
+#else  /* !defined(CONFIG_CLUI_SHELL_TIME) */
+
+static void
+clui_test_exec_timed_words(void)
+{
+}
+
+#endif /* defined(CONFIG_CLUI_SHELL_TIME) */
+
+static int
+clui_test_parse_kword(const struct clui_cmd * cmd __unused,
+                      struct clui_parser *    parser __unused,
+                      const char *            arg __unused,
+                      void *                  ctx __unused)
+{
+	return 0;
+}
+
+static int
+clui_test_parse_switch(const struct clui_cmd * cmd __unused,
+                       struct clui_parser *    parser __unused,
+                       void *                  ctx __unused)
+{
+	return 0;
+}
+
+CLUI_DEFINE_KWORD_PARMS(clui_test_kword_parms,
+                        ("mtu", clui_test_parse_kword),
+                        ("mac", clui_test_parse_kword));
+
+CLUI_DEFINE_SWITCH_PARMS(clui_test_switch_parms,
+                         ("up", clui_test_parse_switch),
+                         ("upper", clui_test_parse_switch));
+
+/* Ambiguous parameter abbreviations are told apart from unknown ones. */
+static void
+clui_test_ambiguous_parms(void)
+{
+	char * const       argv[] = { "clui-test", NULL };
+	char * const       kword[] = { "m", "1500", NULL };
+	char * const       unknown[] = { "x", "1500", NULL };
+	char * const       swtch[] = { "u", NULL };
+	struct clui_parser parser;
+
+	clui_test_expect(!clui_init(&parser, 1, argv));
+	clui_enable_abbrev(&parser, true);
+
+	clui_test_expect(clui_parse_one_kword_parm(&clui_test_run_cmd,
+	                                           &parser,
+	                                           clui_test_kword_parms,
+	                                           2,
+	                                           2,
+	                                           kword,
+	                                           NULL) == -ENOTUNIQ);
+	clui_test_expect(clui_parse_one_kword_parm(&clui_test_run_cmd,
+	                                           &parser,
+	                                           clui_test_kword_parms,
+	                                           2,
+	                                           2,
+	                                           unknown,
+	                                           NULL) == -ENOENT);
+	clui_test_expect(clui_parse_one_switch_parm(&clui_test_run_cmd,
+	                                            &parser,
+	                                            clui_test_switch_parms,
+	                                            2,
+	                                            1,
+	                                            swtch,
+	                                            NULL) == -ENOTUNIQ);
+}
+
+/* Completion callback installing listing hook. */
+static char **
+clui_test_complete(const char *       word __unused,
+                   size_t             len __unused,
+                   int                argc __unused,
+                   const char * const argv[] __unused,
+                   void *             data __unused)
+{
+	return NULL;
+}
+
+int
+main(void)
+{
+	clui_shell_init("clui-test", "test> ", clui_test_complete, NULL, false);
+	rl_initialize();
+	rl_set_screen_size(24, 80);
+
+	clui_test_truncated_single_match();
+	clui_test_fuzzy_prefix_matches();
+	clui_test_exec_words();
+	clui_test_exec_timed_words();
+	clui_test_ambiguous_parms();
+	/*
+	 * Heap-free builds list matches from their own completion key handler
+	 * instead of readline's listing hook.
+	 */
+	if (rl_completion_display_matches_hook) {
+		clui_test_list_path_matches();
+		clui_test_list_multibyte_matches();
+	}
+
+	clui_shell_fini();
+
+	if (clui_test_failures) {
+		fprintf(stderr, "%u check(s) failed.\n", clui_test_failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}